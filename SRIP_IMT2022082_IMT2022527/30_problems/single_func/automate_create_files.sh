@@ -5,34 +5,345 @@ entry_func=""					#The function from which the static analysis is meant to be do
 entry_variable=""				#The variable inside the entry function whose independent variables are to be removed.
 
 sliced_file=""					#Contains sliced code from source file.
-sliced_instrumented_file=""			#Uses sliced_file and inserts the 'simulate_seu' statements.
 crv_check_variable=""				#The variable for which you would like to check it's conditional relevance.
-sliced_instrumented_clean_file=""		#Uses instrumented file and cleans the code of comments and unnecessary code.
-sliced_instrumented_clean_renamed=""		#Uses the cleaned code and renames the function name by adding '_prime_${variable}' to the function name under consideration.
-final_output_file=""				#Uses original source file and the instrumented file to put them together and evaluate their outputs.
+final_output_file=""				#Original source file followed by the instrumented function, renamed by adding '_prime_${variable}' inside instrument_seu.
+						#With several candidate variables, one ${filename}_${variable}_cbmc_ready.c file is written per variable (CRV_JOINT=1: all copies in this file).
+slice_flags="-slicing-level 3"			#Frama-C slicing flags, also part of the slice cache key.
+instrument_flags=(--harness --state "${CRV_STATE:-initial}")	#instrument_seu appends a main asserting the property on line 3 of the source for one step of the original and the instrumented copy.
+cbmc_flags=${CBMC_FLAGS:-"--unwind 10 --trace"}	#CBMC flags, also part of the CBMC cache key (--trace gives the witness bit); --unwind only applies to loops EVA does not bound.
+eva_flags="-eva-precision 1"			#EVA flags for the loop bounds (-seu-unwindset); CRV_UNWINDSET=0 skips the inference.
+crv_jobs="${CRV_JOBS:-$(nproc)}"		#Candidates checked at once when fanning out; automate_file_runs.sh runs each job with 1.
+
+# The harness checks one call of the entry function from the initializers of the globals, so the loop of main is never unrolled.
+# CRV_STATE=nondet starts it from any prior state instead, constrained by CRV_STATE_ASSUME=<expr> (e.g. a queue count within bounds);
+# CRV_STEPS=k chains k calls, and CRV_FEEDBACK=<parameter> passes each return value on to the next call as the main loop does
+[ "${CRV_STEPS:-1}" != "1" ] && instrument_flags+=(--steps "$CRV_STEPS" ${CRV_FEEDBACK:+--feedback "$CRV_FEEDBACK"})
+[ -n "$CRV_STATE_ASSUME" ] && instrument_flags+=(--state-assume "$CRV_STATE_ASSUME")
+
+# Stage outputs are cached by content (see crv_cache.sh); a caller may share CRV_CACHE_STATS to report a whole batch
+source "$(dirname "$0")/crv_cache.sh"
+exit_report=""
+if [ -z "$CRV_CACHE_STATS" ]; then
+    CRV_CACHE_STATS=$(mktemp)
+    exit_report='cache_report; rm -f "$CRV_CACHE_STATS"'
+fi
+
+# Every candidate leaves one JSON record with its verdict, stage times and solver statistics (see crv_results.sh, crv_query.sh)
+source "$(dirname "$0")/crv_results.sh"
+
+# Every stage is timed into collapsed stacks for flamegraph tools, with a top-stages report at the end (see crv_profile.sh)
+source "$(dirname "$0")/crv_profile.sh"
+
+# CBMC runs under wall-clock and memory limits and falls back to smaller --unwind bounds when it hits one (see crv_limits.sh)
+source "$(dirname "$0")/crv_limits.sh"
+cbmc_limits="${CRV_CBMC_TIMEOUT}s ${CRV_CBMC_MEMORY}M ${CRV_UNWIND_FALLBACK}"	#Part of the CBMC cache key: a bounded verdict depends on the limits.
+
+# CRV_PORTFOLIO races several solver backends on every CBMC run and records the winner (see crv_portfolio.sh)
+source "$(dirname "$0")/crv_portfolio.sh"
+cbmc_backends="${CRV_PORTFOLIO:-default}"			#Part of the CBMC cache key: a cached log names the backend that answered.
+
+# Every CRV gets a replay file of its counterexample and a native binary re-executing it (see crv_replay.sh)
+source "$(dirname "$0")/crv_replay.sh"
+
+# A native fuzzing run looks for CRV witnesses before CBMC, which then only has to prove the other candidates non-CRV (see crv_fuzz.sh)
+source "$(dirname "$0")/crv_bits.sh"
+source "$(dirname "$0")/crv_fuzz.sh"
 
 echo "[+] Switching to Frama-C OPAM switch..."
 eval $(opam env --switch=ocaml-frama-work --set-switch)
 eval $(opam env)
 
 echo "Source file path to check for CRVs"
-source_file = $1
+source_file=$1
 #read source_file
 filename="${source_file%.c}"
 sliced_file="${filename}_sliced.c"
-sliced_instrumented_file="${filename}_instru.c"
-sliced_instrumented_clean_file="${filename}_instru_clean.c"
-sliced_instrumented_clean_renamed="${filename}_instru_clean_renamed.c"
 final_output_file="${filename}_cbmc_ready.c"
 
+# A caller may share CRV_PROFILE_FILE to report a whole batch; on its own the run profile is ${filename}_profile.folded
+if [ -z "$CRV_PROFILE_FILE" ]; then
+    CRV_PROFILE_FILE="${filename}_profile.folded"
+    : > "$CRV_PROFILE_FILE"
+    exit_report="${exit_report:+${exit_report}; }profile_report \"\$CRV_PROFILE_FILE\""
+fi
+[ -n "$exit_report" ] && trap "$exit_report" EXIT
+
 echo "Enter the entry point function and the variable you would like to slice for"
 entry_function=$2
 entry_variable=$3
 #read entry_function
 #read entry_variable
 
-frama-c -load-module slicing "$source_file" -main "$entry_function" -slice-value "${entry_variable}" -slicing-level 3 -then-on 'Slicing export' -print -ocode "${sliced_file}"
-echo "Finished static analysis on ${source_file} file. The sliced code is now available in file ${sliced_file}"
+# The slice only depends on the output variable, so all candidates of one (file, function, output) group share it
+variables=("${@:4}")
+
+# Without candidates (or with --all) every parameter, volatile global and local of the function is classified:
+# the ones missing from the slice are non-CRVs right away, the others go through instrumentation and CBMC
+enumerate=0
+if [ ${#variables[@]} -eq 0 ] || [ "${variables[0]}" = "--all" ]; then
+    enumerate=1
+    variables=()
+fi
+
+# Combined file of one candidate variable
+output_file_for() {
+    if [ ${#variables[@]} -gt 1 ] || [ "$enumerate" = "1" ]; then
+        echo "${filename}_$1_cbmc_ready.c"
+    else
+        echo "$final_output_file"
+    fi
+}
+
+frama_c_version=$(frama-c -version 2> /dev/null)
+cbmc_version=$(cbmc --version 2> /dev/null)
+instrument_seu_version=$(sha256sum < ./instrument_seu 2> /dev/null | cut -c 1-12)
+
+start=$(now_ms)
+preprocessed_file=$(mktemp)
+cache_preprocessed "$source_file" "$preprocessed_file"
+slice_key=$(cache_key slice "@${preprocessed_file}" "$entry_function" "$entry_variable" "$frama_c_version" "$slice_flags")
+rm -f "$preprocessed_file"
+source_preprocess_ms=$(( $(now_ms) - start ))
+slice_cached=""
+
+# First frame of the collapsed stacks: the job for shared stages, the job and variable for per-candidate ones
+job_frame="$(basename "$filename"):${entry_function}:${entry_variable}"
+profile_sample "${job_frame};preprocess" "$source_preprocess_ms"
+
+# Profile frame of the candidates checked in one combined file
+candidate_frame() {
+    if [ $# -gt 1 ]; then
+        echo "${job_frame}:joint"
+    else
+        echo "${job_frame}:$1"
+    fi
+}
+
+# The result line and the counterexample of one candidate's assertion in a joint CBMC log, followed by a verdict line for that
+# assertion alone, so the log of every candidate reads like the log of a single-candidate run
+property_log() {
+    local log_file=$1 variable=$2
+    local property=$(sed -n "s/^\[\([^]]*\)\] .* ${variable} is a CRV: .*/\1/p" "$log_file" | head -1)
+    grep "^CRV-LIMIT: \|^CRV-BOUND: \|^CRV-BACKEND: \|^Solving with \|^Running SMT2 \|^Runtime \|^size of program expression\|variables, .* clauses" "$log_file"
+    [ -n "$property" ] || return 0
+    grep -F "[${property}] " "$log_file"
+    awk -v trace="Trace for ${property}:" '$0 == trace { on = 1 } on && ((/^Trace for / && $0 != trace) || /^\*\* /) { on = 0 } on' "$log_file"
+    grep "unwinding assertion .*: FAILURE" "$log_file"
+    grep -F "[${property}] " "$log_file" | grep -q ": FAILURE" && echo "VERIFICATION FAILED"
+    grep -F "[${property}] " "$log_file" | grep -q ": SUCCESS" && echo "VERIFICATION SUCCESSFUL"
+}
+
+# Runs CBMC on the harness of a combined file (or restores its log from the cache), writes CRV, non-CRV or ERROR to the .verdict
+# file of every candidate variable checked in it and records them; instrument_ms and the cached stages so far are passed in.
+# A joint file (CRV_JOINT=1) asserts all candidates in one CBMC run, whose log is split per candidate with property_log
+check_crv() {
+    local output_file=$1 instrument_ms=$2 cached=$3
+    shift 3
+    local check_variables=("$@")
+    local log_file="${output_file%.c}_cbmc.log"
+    local preprocessed_file="${output_file%.c}.i"
+    local frame=$(candidate_frame "$@")
+    local variable
+    if [ ! -s "$output_file" ]; then
+        for variable in "${check_variables[@]}"; do
+            echo "ERROR" > "$(output_file_for "$variable" | sed 's/\.c$//').verdict"
+            write_result "$(output_file_for "$variable")" "$variable" "ERROR" "$slice_ms" 0 "$instrument_ms" 0 "$cached" /dev/null "instrumentation failed"
+        done
+        return 1
+    fi
+
+    # Loop bounds of the combined file from EVA (seu plugin), with CBMC's loop numbers, e.g. step.0:8,step_prime_x.0:8.
+    # Frama-C lives in the other OPAM switch, and the bounds are cached on the combined file
+    local start=$(now_ms)
+    local unwindset=""
+    if [ "${CRV_UNWINDSET}" != "0" ]; then
+        local unwindset_file="${output_file%.c}.unwindset"
+        # Bounds above the global --unwind are left out, so an unbounded counter cannot override it
+        local unwind_max=$(echo "$cbmc_flags" | sed -n 's/.*--unwind \([0-9]*\).*/\1/p')
+        local unwindset_key=$(cache_key unwindset "@${output_file}" "@simulate_seu.h" "$frama_c_version" "$eva_flags" "${unwind_max:-0}")
+        if cache_fetch unwindset "$unwindset_key" "$unwindset_file"; then
+            profile_sample "${frame};unwindset;cache" "$(( $(now_ms) - start ))"
+        else
+            opam exec --switch=ocaml-frama-work -- frama-c -eva $eva_flags -main main "$output_file" -seu-unwindset "$unwindset_file" -seu-unwind-max "${unwind_max:-0}" > "${output_file%.c}_eva.log" 2>&1
+            cache_store unwindset "$unwindset_key" "$unwindset_file"
+            profile_sample "${frame};unwindset;eva" "$(( $(now_ms) - start ))"
+        fi
+        unwindset=$(cat "$unwindset_file" 2> /dev/null)
+    fi
+    # With inferred bounds, unwinding assertions make a bound that is too low fail instead of cutting paths silently
+    local run_flags="$cbmc_flags${unwindset:+ --unwindset ${unwindset}}"
+    [ -n "$unwindset" ] && [[ " $cbmc_flags " != *" --unwinding-assertions "* ]] && run_flags+=" --unwinding-assertions"
+
+    # The instrumented copies come from the slice, but the harness also runs the original function with every global and callee
+    # of the source, so the key covers the combined file as well as the slice fingerprint and the property
+    start=$(now_ms)
+    local cbmc_key
+    if [ -n "$slice_fingerprint" ]; then
+        cbmc_key=$(cache_key cbmc "$slice_fingerprint" "$entry_function" "${check_variables[*]}" "$(sed -n 3p "$source_file")" \
+            "@${output_file}" "@./instrument_seu" "${instrument_flags[*]}" "@simulate_seu.h" "$cbmc_version" "$run_flags" "$cbmc_limits" "$cbmc_backends")
+    else
+        cache_preprocessed "$output_file" "$preprocessed_file"
+        cbmc_key=$(cache_key cbmc "@${preprocessed_file}" "$cbmc_version" "$run_flags" "$cbmc_limits" "$cbmc_backends")
+        rm -f "$preprocessed_file"
+    fi
+    profile_sample "${frame};preprocess" "$(( $(now_ms) - start ))"
+    local preprocess_ms=$(( $(now_ms) - start + source_preprocess_ms ))
+
+    start=$(now_ms)
+    local remaining=("${check_variables[@]}") fuzz_ms=0
+    if cache_fetch cbmc "$cbmc_key" "$log_file"; then
+        cached="${cached:+${cached}, }\"cbmc\""
+        profile_sample "${frame};cbmc;cache" "$(( $(now_ms) - start ))"
+    else
+        # Fuzzing first: a candidate with a reproduced witness is a CRV without a CBMC run, which is left to prove the others non-CRV
+        if [ "${CRV_FUZZ}" != "0" ]; then
+            local witness_file="${output_file%.c}.witnesses" fuzzed=0 fuzz_cached
+            remaining=()
+            for variable in "${check_variables[@]}"; do
+                local record_file=$(output_file_for "$variable")
+                local replay_file="${record_file%.c}.replay" fuzz_key=$(cache_key fuzz "$cbmc_key" "$variable")
+                fuzz_cached=""
+                if cache_fetch fuzz "$fuzz_key" "$replay_file"; then
+                    fuzz_cached=", \"fuzz\""
+                else
+                    # One attempt per file: a driver that fails to build is not rebuilt for every candidate
+                    if [ "$fuzzed" = "0" ]; then
+                        fuzz_run "$output_file" "$witness_file" && fuzzed=1 || fuzzed=failed
+                    fi
+                    if [ "$fuzzed" != "1" ] || ! fuzz_witness "$witness_file" "$variable" "$replay_file"; then
+                        remaining+=("$variable")
+                        continue
+                    fi
+                fi
+                # A witness only counts once the native replay reproduces it
+                replay_build "$output_file" "$replay_file" "$(replay_binary "$record_file")"
+                "$(replay_binary "$record_file")" > "${record_file%.c}_replay.log" 2>&1
+                if [ $? -ne 10 ]; then
+                    echo "[!] ${variable}: the fuzz witness does not reproduce, leaving it to CBMC"
+                    rm -f "$replay_file"
+                    remaining+=("$variable")
+                    continue
+                fi
+                [ -z "$fuzz_cached" ] && cache_store fuzz "$fuzz_key" "$replay_file"
+                fuzz_ms=$(( $(now_ms) - start ))
+                echo "CRV" > "${record_file%.c}.verdict"
+                write_result "$record_file" "$variable" "CRV" "$slice_ms" "$preprocess_ms" "$instrument_ms" 0 "${cached}${fuzz_cached}" "$replay_file" \
+                    "fuzz witness$( [ -n "$fuzz_cached" ] || echo " in $(fuzz_trials "$witness_file") trials")"
+                echo "[+] ${variable}: CRV (fuzz witness in ${replay_file}, native replay $(replay_binary "$record_file"))"
+            done
+            rm -f "$witness_file"
+            fuzz_ms=$(( $(now_ms) - start ))
+            profile_sample "${frame};fuzz" "$fuzz_ms"
+            start=$(now_ms)
+        fi
+        if [ ${#remaining[@]} -gt 0 ]; then
+            cbmc_governed "$output_file" "$log_file" "${frame};cbmc" $run_flags $(profile_enabled && echo "$cbmc_profile_flags")
+            grep -q "VERIFICATION \(SUCCESSFUL\|FAILED\)" "$log_file" && cache_store cbmc "$cbmc_key" "$log_file"
+        fi
+    fi
+    local cbmc_ms=$(( $(now_ms) - start ))
+
+    for variable in "${remaining[@]}"; do
+        local record_file=$(output_file_for "$variable")
+        local variable_log="$log_file"
+        if [ ${#check_variables[@]} -gt 1 ]; then
+            variable_log="${record_file%.c}_cbmc.log"
+            property_log "$log_file" "$variable" > "$variable_log"
+        fi
+
+        # After a limit, a counterexample at a smaller bound still makes a CRV, but a success only makes it non-CRV up to that bound
+        local verdict="ERROR" reason="cbmc"
+        [ ${#check_variables[@]} -gt 1 ] && reason="cbmc, joint run of ${#check_variables[@]} candidates"
+        grep -q "VERIFICATION FAILED" "$variable_log" && verdict="CRV"
+        grep -q "VERIFICATION SUCCESSFUL" "$variable_log" && verdict="non-CRV"
+        # Only a failure of the candidate's own assertion is a CRV; a failed unwinding assertion means a loop bound was too low
+        if grep -q "unwinding assertion .*: FAILURE" "$variable_log" && ! grep -q " ${variable} is a CRV: FAILURE" "$variable_log"; then
+            verdict="bounded"
+            reason="unwinding assertion failed: $(sed -n 's/^\[\([^]]*\)\] .*unwinding assertion.*: FAILURE/\1/p' "$variable_log" | paste -sd ',') needs a higher bound"
+        fi
+        if grep -q "^CRV-LIMIT: " "$variable_log"; then
+            reason=$(sed -n 's/^CRV-LIMIT: \(.*\)/\1/p; s/^CRV-BOUND: \(.*\)/checked at \1/p' "$variable_log" | paste -sd ';' | sed 's/;/; /g')
+            [ "$verdict" = "non-CRV" ] && verdict="bounded"
+        fi
+        echo "$verdict" > "${record_file%.c}.verdict"
+        if [ "$verdict" = "CRV" ] && [ "${CRV_REPLAY}" != "0" ]; then
+            start=$(now_ms)
+            local replay_key=$(cache_key replay "$cbmc_key" "$variable" "@$(dirname "$0")/crv_replay.sh")
+            if cache_fetch replay "$replay_key" "${record_file%.c}.replay"; then
+                replay_build "$output_file" "${record_file%.c}.replay" "$(replay_binary "$record_file")"
+                profile_sample "${frame};replay;cache" "$(( $(now_ms) - start ))"
+            else
+                replay_counterexample "$output_file" "$log_file" "$variable" "$record_file" $run_flags &&
+                    cache_store replay "$replay_key" "${record_file%.c}.replay"
+                profile_sample "${frame};replay" "$(( $(now_ms) - start ))"
+            fi
+        fi
+        write_result "$record_file" "$variable" "$verdict" "$slice_ms" "$preprocess_ms" "$instrument_ms" "$cbmc_ms" "$cached" "$variable_log" "$reason"
+        echo "[+] ${variable}: ${verdict} (CBMC log in ${variable_log}, record in ${record_file%.c}.json)"
+    done
+}
+
+# CRV_FRONTEND=frama-c instruments inside the sliced project with the seu plugin (see seuPlugin/),
+# skipping the _sliced.c file and the switch to the CIL OPAM switch
+if [ "${CRV_FRONTEND}" = "frama-c" ]; then
+    if [ "$enumerate" = "1" ]; then
+        echo "[!] Candidate enumeration needs instrument_seu --list-vars; run without CRV_FRONTEND=frama-c"
+        exit 1
+    fi
+    missing=()
+    for variable in "${variables[@]}"; do
+        instrument_key=$(cache_key seu-plugin "$slice_key" "@${source_file}" "$variable")
+        if cache_fetch instrument "$instrument_key" "$(output_file_for "$variable")"; then
+            echo "[+] Combined file restored from cache: $(output_file_for "$variable")"
+        else
+            missing+=("$variable")
+        fi
+    done
+    [ ${#missing[@]} -eq 0 ] && exit 0
+
+    # One Frama-C run slices once and writes one file per candidate (%v in -seu-output)
+    output_pattern=$(output_file_for "%v")
+    start=$(now_ms)
+    frama-c -load-module slicing "$source_file" -main "$entry_function" -slice-value "${entry_variable}" $slice_flags -then-on 'Slicing export' -seu-entry "${entry_function}" -seu-var "$(IFS=,; echo "${missing[*]}")" -seu-combine "${source_file}" -seu-output "${output_pattern}"
+    profile_sample "${job_frame};slice;frama-c-seu" "$(( $(now_ms) - start ))"
+    for variable in "${missing[@]}"; do
+        cache_store instrument "$(cache_key seu-plugin "$slice_key" "@${source_file}" "$variable")" "$(output_file_for "$variable")"
+        echo "[+] Combined file created: $(output_file_for "$variable")"
+    done
+    for variable in "${variables[@]}"; do
+        echo "UNCHECKED" > "$(output_file_for "$variable" | sed 's/\.c$//').verdict"
+    done
+    echo "[!] The seu plugin does not generate the CBMC harness yet; add it by hand before running CBMC"
+    exit 0
+fi
+
+start=$(now_ms)
+slice_stage="frama-c"
+if cache_fetch slice "$slice_key" "$sliced_file"; then
+    slice_cached="\"slice\""
+    slice_stage="cache"
+    echo "Sliced code for ${source_file} restored from cache into ${sliced_file}"
+else
+    frama-c -load-module slicing "$source_file" -main "$entry_function" -slice-value "${entry_variable}" $slice_flags -then-on 'Slicing export' -print -ocode "${sliced_file}"
+    cache_store slice "$slice_key" "$sliced_file"
+    echo "Finished static analysis on ${source_file} file. The sliced code is now available in file ${sliced_file}"
+fi
+slice_ms=$(( $(now_ms) - start ))
+profile_sample "${job_frame};slice;${slice_stage}" "$slice_ms"
+
+# The whole program as Frama-C normalizes it, which CIL parses like the sliced file, to list the candidates before slicing
+full_file="${filename}_full.c"
+if [ "$enumerate" = "1" ]; then
+    start=$(now_ms)
+    full_key=$(cache_key print "@${source_file}" "$frama_c_version")
+    if cache_fetch print "$full_key" "$full_file"; then
+        profile_sample "${job_frame};print;cache" "$(( $(now_ms) - start ))"
+    else
+        frama-c "$source_file" -print -ocode "${full_file}" > /dev/null
+        cache_store print "$full_key" "$full_file"
+        profile_sample "${job_frame};print;frama-c" "$(( $(now_ms) - start ))"
+    fi
+fi
 
 echo "[+] Switching to CIL OPAM switch..."
 eval $(opam env --switch=ocaml-cil-work --set-switch)
@@ -40,26 +351,86 @@ eval $(opam env)
 
 echo "Ensure that 'instrument_seu' executable is present in the current working directory"
 echo "What variable would you like to check the instrumentation of"
-variable=$4
 #read variable
 
-./instrument_seu "${sliced_file}" "${sliced_instrumented_file}" "${variable}"
-
-echo "Finished preparing instrumented code. Available in ${sliced_instrumented_file} file. Cleaning it now."
-gcc -E -P "${sliced_instrumented_file}" -o "${sliced_instrumented_clean_file}"
-
-echo "Instrumented function now present in ${sliced_instrumented_clean_file}"
-
-echo "Moving on to modify the cleaned code by adding '_prime_${variable}' to the function '${entry_function}'"
-new_func_name="${entry_function}_prime_${variable}"
-sed "s/\b${entry_function}\b/${new_func_name}/g" "$sliced_instrumented_clean_file" > "$sliced_instrumented_clean_renamed"
+# Fingerprint of the slice; the previous one of this (file, function, output) tells which sliced functions an edit touched
+slice_fingerprint=""
+fingerprint_file="${filename}_sliced.fingerprint"
+tool_profile=$(mktemp)
+start=$(now_ms)
+./instrument_seu --fingerprint $(profile_flag "$tool_profile") "${sliced_file}" > "$fingerprint_file" 2> /dev/null
+fingerprint_status=$?
+profile_nested "${job_frame};fingerprint" "$(( $(now_ms) - start ))" "$tool_profile"
+if [ "$fingerprint_status" = "0" ]; then
+    slice_fingerprint=$(sed -n 's/^<slice> //p' "$fingerprint_file")
+    history_file="${CRV_CACHE_DIR}/fingerprints/$(basename "$filename")_${entry_function}_${entry_variable}"
+    if [ -f "$history_file" ] && ! cmp -s "$history_file" "$fingerprint_file"; then
+        echo "[+] Slice changed since the last run in: $(diff "$history_file" "$fingerprint_file" | sed -n '/^> <slice>/d; s/^> \([^ ]*\) .*/\1/p' | tr '\n' ' ')"
+    elif [ -f "$history_file" ]; then
+        echo "[+] Slice unchanged since the last run (${slice_fingerprint})"
+    fi
+    [ "${CRV_CACHE}" = "0" ] || { mkdir -p "$(dirname "$history_file")" && cp "$fingerprint_file" "$history_file"; }
+else
+    rm -f "$fingerprint_file"
+fi
 
-echo "Finished renaming the function. Saved to ${sliced_instrumented_clean_renamed}"
+if [ "$enumerate" = "1" ]; then
+    start=$(now_ms)
+    in_slice=" $(./instrument_seu --entry "${entry_function}" --list-vars used $(profile_flag "$tool_profile") "${sliced_file}" | cut -d ' ' -f 2 | tr '\n' ' ') "
+    profile_nested "${job_frame};list-vars;sliced" "$(( $(now_ms) - start ))" "$tool_profile"
+    start=$(now_ms)
+    while read -r kind variable; do
+        if [[ "$in_slice" == *" ${variable} "* ]]; then
+            variables+=("$variable")
+        else
+            echo "non-CRV" > "$(output_file_for "$variable" | sed 's/\.c$//').verdict"
+            write_result "$(output_file_for "$variable")" "$variable" "non-CRV" "$slice_ms" 0 0 0 "" /dev/null "not in slice"
+            echo "[+] ${variable} (${kind}): non-CRV (not in the slice of ${entry_variable})"
+        fi
+    done < <(./instrument_seu --entry "${entry_function}" --list-vars all $(profile_flag "$tool_profile") "${full_file}")
+    profile_nested "${job_frame};list-vars;full" "$(( $(now_ms) - start ))" "$tool_profile"
+    echo "[+] Candidates in the slice of ${entry_variable}: ${variables[*]}"
+fi
+rm -f "$tool_profile"
 
-echo "Creating the Final C file for testing the concept"
-cp "${source_file}" "${final_output_file}"
-echo -e "\n\n// ----- Renamed Instrumented Function -----\n" >> "${final_output_file}"
-sed -i 's/\r$//' "$final_output_file"
-cat "$sliced_instrumented_clean_renamed" >> "$final_output_file"
+# Instruments the candidates given into one combined file (or restores it from the cache) and checks it
+instrument_and_check() {
+    local output_file=$1
+    shift
+    local frame=$(candidate_frame "$@")
+    local cached="$slice_cached"
+    local start=$(now_ms)
+    # The instrumented file depends on the sliced code, the verbatim source it is appended to and the instrument_seu binary itself
+    local instrument_key=$(cache_key instrument "@${sliced_file}" "@${source_file}" "$entry_function" "$*" "@./instrument_seu" "--combine" "${instrument_flags[*]}")
+    if cache_fetch instrument "$instrument_key" "$output_file"; then
+        cached="${cached:+${cached}, }\"instrument\""
+        profile_sample "${frame};instrument;cache" "$(( $(now_ms) - start ))"
+        echo "[+] Combined file restored from cache: $output_file"
+    else
+        local tool_profile="${output_file%.c}.profile"
+        ./instrument_seu --entry "${entry_function}" --combine "${source_file}" "${instrument_flags[@]}" $(profile_flag "$tool_profile") "${sliced_file}" "${output_file}" "$@"
+        cache_store instrument "$instrument_key" "$output_file"
+        profile_nested "${frame};instrument" "$(( $(now_ms) - start ))" "$tool_profile"
+        rm -f "$tool_profile"
+        echo "[+] Combined file created: $output_file"
+    fi
+    check_crv "$output_file" "$(( $(now_ms) - start ))" "$cached" "$@"
+}
 
-echo "[+] Combined file created: $final_output_file"
+# CRV_JOINT=1 asserts all candidates in one combined file, so a single CBMC run encodes the original function once for all of them;
+# otherwise (fan out) every candidate is instrumented from the shared sliced file and checked in its own process
+if [ "${CRV_JOINT}" = "1" ] && [ ${#variables[@]} -gt 1 ]; then
+    instrument_and_check "$final_output_file" "${variables[@]}"
+else
+    # At most crv_jobs candidates at once, each with its own fuzzing, EVA and CBMC runs under the limits of crv_limits.sh
+    running=0
+    for variable in "${variables[@]}"; do
+        instrument_and_check "$(output_file_for "$variable")" "$variable" &
+        running=$((running + 1))
+        if [ "$running" -ge "$crv_jobs" ]; then
+            wait -n
+            running=$((running - 1))
+        fi
+    done
+    wait
+fi
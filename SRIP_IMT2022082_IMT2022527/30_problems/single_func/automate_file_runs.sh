@@ -1,13 +1,21 @@
 #!/bin/bash
 
-##Takes inputs to run the automate_create_files.sh, this creates the *_cbmc_ready.c which we then insert the queue statements and then check to see if the variable under consideration is infact a CRV or a non-CRV.
+##Runs automate_create_files.sh for every entry of a manifest, which creates the *_cbmc_ready.c files we then check to see if the variable under consideration is infact a CRV or a non-CRV.
+##Each entry is 'file|function|output|variable' ('*' as the variable classifies every candidate of the function); entries sharing (file, function, output) form one job that slices once and instruments every
+##candidate variable from that slice. Jobs run on a bounded worker pool, each one in its own scratch directory.
+##Usage: ./automate_file_runs.sh [manifest] [workers]   (without a manifest the entries below are used)
+
+manifest=$1					#File with one 'file|function|output|variable' entry per line ('#' starts a comment).
+workers=${2:-$(nproc)}				#Number of jobs running at once.
+runs_dir="runs"					#Contains one scratch directory per job, named <n>_<file>_<output>.
+
 entries=(
     "automated_greenhouse_vent_controller.c|step_control_logic|new_vent_opening|current_temp"
     "automated_greenhouse_vent_controller.c|step_control_logic|new_vent_opening|target_temp"
     "automotive_abs_controller.c|step|new_pressure|slip_target"
     "automotive_abs_controller.c|step|new_pressure|driver_brake_request"
-    "batter_management_system.c|step|new_current|target_current"
-    "batter_management_system.c|step|new_current|pack_temp_c"
+    "battery_management_system.c|step|new_current|target_current"
+    "battery_management_system.c|step|new_current|pack_temp_c"
     "chemical_reactor_controller.c|step_heater|new_heater_duty|target_temp"
     "chemical_reactor_controller.c|step_heater|new_heater_duty|reaction_phase"
     "data_center_cooling_unit.c|step|new_state|water_leak"
@@ -15,22 +23,128 @@ entries=(
     "data_center_cooling_unit.c|step|new_state|rack_inlet_temp_c"
     "drone_motor_controller.c|step|new_throttle|battery_voltage_mv"
     "drone_motor_controller.c|step|new_throttle|armed_flight_mode"
-    "elevateor_door_controller.c|step|new_force|special_hold_profile_active"
-    "elevateor_door_controller.c|step|new_force|close_door"
-    "elevateor_door_controller.c|step|new_force|obstruction_detected"
-    "elevateor_door_controller.c|step|new_force|hold_open_timer"
+    "elevator_door_controller.c|step|new_force|special_hold_profile_active"
+    "elevator_door_controller.c|step|new_force|close_door"
+    "elevator_door_controller.c|step|new_force|obstruction_detected"
+    "elevator_door_controller.c|step|new_force|hold_open_timer"
 )
 
+if [ -n "$manifest" ]; then
+    if [ ! -f "$manifest" ]; then
+        echo "Usage: $0 [manifest] [workers]"
+        exit 1
+    fi
+    entries=()
+    while IFS= read -r line; do
+        line="${line%%#*}"
+        [ -n "${line// }" ] && entries+=("$line")
+    done < "$manifest"
+fi
+
+script_dir=$(cd "$(dirname "$0")" && pwd)
+mkdir -p "$runs_dir"
+
+# All jobs append their cache hits and misses to one file, reported once at the end (see crv_cache.sh)
+export CRV_CACHE_STATS="$(pwd)/${runs_dir}/cache_stats"
+# All records of this batch share one run ID in the results store (see crv_results.sh, crv_query.sh)
+export CRV_RUN_ID="${CRV_RUN_ID:-$(date +%Y%m%d-%H%M%S)-$$}"
+# All jobs append their stage times to one collapsed-stack file, for the top-stages report and flamegraph tools (see crv_profile.sh)
+export CRV_PROFILE_FILE="$(pwd)/${runs_dir}/profile.folded"
+rm -f "$CRV_CACHE_STATS" "$CRV_PROFILE_FILE"
+source "${script_dir}/crv_cache.sh"
+source "${script_dir}/crv_profile.sh"
+
+now_s() {
+    date +%s.%N
+}
+
+# Group the entries by (file, function, output), keeping the manifest order
+groups=()
+declare -A group_variables
 for entry in "${entries[@]}"; do
-  IFS='|' read -r filename step_name output_name var_name <<< "$entry"
-  echo "--------------------------------------------------------------------------------------------------------------------------------------"
-  ./automate_create_files.sh filename step_name output_name var_name
-
-  while true; do
-    read -p "Type NEXT to continue: " input
-    if [[ "$input" == "NEXT" ]]; then
-      break
+    IFS='|' read -r filename step_name output_name var_name <<< "$entry"
+    group="${filename}|${step_name}|${output_name}"
+    [ -z "${group_variables[$group]+set}" ] && groups+=("$group")
+    [ "$var_name" = "*" ] && var_name="--all"
+    group_variables[$group]+="${var_name} "
+done
+
+# Combined file of one candidate, as named by automate_create_files.sh
+output_file_for() {
+    local filename=$1 var_name=$2 per_variable=$3
+    if [ "$per_variable" = "1" ]; then
+        echo "${filename%.c}_${var_name}_cbmc_ready.c"
+    else
+        echo "${filename%.c}_cbmc_ready.c"
+    fi
+}
+
+# Runs one group inside its own scratch directory, so concurrent jobs never share the _sliced.c and _cbmc_ready.c files
+run_job() {
+    local job_dir=$1 filename=$2 step_name=$3 output_name=$4
+    shift 4
+    local start=$(now_s)
+
+    cp "${script_dir}/${filename}" "${script_dir}/simulate_seu.h" "${script_dir}/queue.h" "$job_dir/"
+    ln -sf "${script_dir}/instrument_seu" "$job_dir/instrument_seu"
+
+    # The pool already bounds the parallelism, so each job checks its candidates one at a time unless CRV_JOBS says otherwise
+    (cd "$job_dir" && CRV_JOBS="${CRV_JOBS:-1}" bash "${script_dir}/automate_create_files.sh" "$filename" "$step_name" "$output_name" "$@") > "$job_dir/job.log" 2>&1
+
+    awk -v s="$start" -v e="$(now_s)" 'BEGIN { printf "%.1f\n", e - s }' > "$job_dir/job.time"
+}
+
+running=0
+job=0
+start=$(now_s)
+
+for group in "${groups[@]}"; do
+    IFS='|' read -r filename step_name output_name <<< "$group"
+    job=$((job + 1))
+    job_dir="${runs_dir}/${job}_${filename%.c}_${output_name}"
+    rm -rf "$job_dir" && mkdir -p "$job_dir"
+
+    run_job "$job_dir" "$filename" "$step_name" "$output_name" ${group_variables[$group]} &
+    running=$((running + 1))
+    if [ "$running" -ge "$workers" ]; then
+        wait -n
+        running=$((running - 1))
     fi
-  done
 done
+wait
+
+elapsed=$(awk -v s="$start" -v e="$(now_s)" 'BEGIN { printf "%.1f", e - s }')
 
+echo "--------------------------------------------------------------------------------------------------------------------------------------"
+printf "%-8s %-8s %-45s %-30s %s\n" "verdict" "time_s" "file" "variable" "log"
+job=0
+candidates=0
+failed=0
+for group in "${groups[@]}"; do
+    IFS='|' read -r filename step_name output_name <<< "$group"
+    job=$((job + 1))
+    job_dir="${runs_dir}/${job}_${filename%.c}_${output_name}"
+    job_time=$(cat "$job_dir/job.time" 2> /dev/null)
+    variables=(${group_variables[$group]})
+    per_variable=0
+    [ ${#variables[@]} -gt 1 ] && per_variable=1
+    if [ "${variables[0]}" = "--all" ]; then
+        # Enumerated candidates are only known from the records the job wrote
+        per_variable=1
+        variables=($(sed -n 's/.*"variable": "\([^"]*\)".*/\1/p' "$job_dir"/*.json 2> /dev/null))
+    fi
+    for var_name in "${variables[@]}"; do
+        candidates=$((candidates + 1))
+        output_file="$job_dir/$(output_file_for "$filename" "$var_name" "$per_variable")"
+        # CRV, non-CRV or ERROR as recorded by the job, FAILED when it did not get that far
+        status=$(cat "${output_file%.c}.verdict" 2> /dev/null)
+        [ -n "$status" ] || status="FAILED"
+        [ "$status" = "FAILED" ] || [ "$status" = "ERROR" ] && failed=$((failed + 1))
+        printf "%-8s %-8s %-45s %-30s %s\n" "$status" "${job_time:--}" "$filename" "$var_name" "$job_dir/job.log"
+    done
+done
+echo "--------------------------------------------------------------------------------------------------------------------------------------"
+echo "[+] ${candidates} candidates (${failed} failed) in ${job} slicing jobs with ${workers} workers in ${elapsed} s: $(awk -v n="$candidates" -v t="$elapsed" 'BEGIN { printf "%.1f", (t > 0 ? n * 60 / t : 0) }') candidates/minute"
+cache_report
+profile_report "$CRV_PROFILE_FILE"
+echo "[+] Results of run ${CRV_RUN_ID} appended to the results store (./crv_query.sh summary ${CRV_RUN_ID})"
@@ -0,0 +1,133 @@
+#!/bin/bash
+
+##Per-bit split mode: instead of one CBMC run with a symbolic bit position, emit one variant of the *_cbmc_ready.c file per bit
+##(pinned with SEU_FIXED_BIT, see simulate_seu.h), solve the variants on a pool of workers and stop at the first FAILURE.
+##Usage: ./automate_split_bits.sh <cbmc_ready_file> [bits] [workers] [extra cbmc flags...]
+##e.g.   ./automate_split_bits.sh medical_infusion_pump_cbmc_ready.c auto 32 --unwind 10
+##By default (bits = auto) the variants cover exactly the bits the SEU models of the file can flip (see crv_bits.sh); a smaller
+##explicit count is refused, since a non-CRV verdict would then leave bits unchecked.
+##Set SPLIT_COMPARE=1 to also time the single symbolic run for comparison.
+
+cbmc_ready_file=$1				#File produced by automate_create_files.sh (with the harness and assertion added).
+bits=${2:-auto}					#Variants for bits 0..bits-1, or auto for the bits of the file's SEU models.
+workers=${3:-$(nproc)}				#Number of CBMC processes running at once.
+shift $(( $# < 3 ? $# : 3 ))
+cbmc_flags=("$@")
+
+if [ -z "$cbmc_ready_file" ] || [ ! -f "$cbmc_ready_file" ]; then
+    echo "Usage: $0 <cbmc_ready_file> [bits] [workers] [extra cbmc flags...]"
+    exit 1
+fi
+
+source "$(dirname "$0")/crv_bits.sh"
+read -r first_bit last_bit < <(seu_bit_range "$cbmc_ready_file")
+if [ "$bits" = "auto" ]; then
+    bits=$((last_bit + 1))
+elif [ "$bits" -le "$last_bit" ]; then
+    echo "[!] The SEU models of ${cbmc_ready_file} flip bits ${first_bit}..${last_bit}: pass at least $((last_bit + 1)) bits (or auto)"
+    exit 1
+fi
+variants=$((bits - first_bit))
+
+filename="${cbmc_ready_file%.c}"
+split_dir="${filename}_bits"			#Contains ${filename}_bit<n>.c and the CBMC log of every variant.
+mkdir -p "$split_dir"
+rm -f "${split_dir}"/*.verdict
+
+now_ms() {
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# Each variant is the original file with the bit position pinned before simulate_seu.h is included
+for ((bit = first_bit; bit < bits; bit++)); do
+    variant="${split_dir}/$(basename "$filename")_bit${bit}.c"
+    { echo "#define SEU_FIXED_BIT ${bit}"; cat "$cbmc_ready_file"; } > "$variant"
+done
+echo "[+] ${variants} bit variants (bits ${first_bit}..$((bits - 1))) written to ${split_dir}"
+
+# CBMC verdicts are cached by content (see crv_cache.sh), keyed on the preprocessed variant, the CBMC version and the flags
+source "$(dirname "$0")/crv_cache.sh"
+if [ -z "$CRV_CACHE_STATS" ]; then
+    CRV_CACHE_STATS=$(mktemp)
+    trap 'cache_report; rm -f "$CRV_CACHE_STATS"' EXIT
+fi
+cbmc_version=$(cbmc --version 2> /dev/null)
+
+# Every variant runs under the wall-clock and memory limits of crv_limits.sh; one that hits them is reported as LIMIT, not retried
+source "$(dirname "$0")/crv_limits.sh"
+
+# Runs one variant (or restores its log from the cache) and leaves its verdict in <variant>.verdict
+solve_variant() {
+    local variant=$1
+    local preprocessed_file="${variant%.c}.i"
+    gcc -E -P "$variant" -I "$(pwd)" > "$preprocessed_file" 2> /dev/null || cp "$variant" "$preprocessed_file"
+    local key=$(cache_key cbmc "@${preprocessed_file}" "$cbmc_version" "${cbmc_flags[*]}")
+
+    if ! cache_fetch cbmc "$key" "${variant%.c}.log"; then
+        run_limited "${variant%.c}.log" cbmc "$variant" -I "$(pwd)" "${cbmc_flags[@]}"
+        if [ -n "$(limit_hit $? "${variant%.c}.log")" ]; then
+            echo "LIMIT" > "${variant%.c}.verdict"
+            return
+        fi
+        grep -q "VERIFICATION \(SUCCESSFUL\|FAILED\)" "${variant%.c}.log" && cache_store cbmc "$key" "${variant%.c}.log"
+    fi
+
+    if grep -q "VERIFICATION SUCCESSFUL" "${variant%.c}.log"; then
+        echo "SUCCESS" > "${variant%.c}.verdict"
+    elif grep -q "VERIFICATION FAILED" "${variant%.c}.log"; then
+        echo "FAILURE" > "${variant%.c}.verdict"
+    else
+        echo "ERROR" > "${variant%.c}.verdict"
+    fi
+}
+
+failed_bit=""
+running=0
+start=$(now_ms)
+
+for ((bit = first_bit; bit < bits; bit++)); do
+    variant="${split_dir}/$(basename "$filename")_bit${bit}.c"
+    solve_variant "$variant" &
+    running=$((running + 1))
+
+    # Wait for a free worker, checking for a FAILURE every time one finishes
+    while [ "$running" -ge "$workers" ]; do
+        wait -n
+        running=$((running - 1))
+        failed_bit=$(grep -l FAILURE "${split_dir}"/*.verdict 2> /dev/null | head -1)
+        [ -n "$failed_bit" ] && break 2
+    done
+done
+
+while [ -z "$failed_bit" ] && [ "$running" -gt 0 ]; do
+    wait -n
+    running=$((running - 1))
+    failed_bit=$(grep -l FAILURE "${split_dir}"/*.verdict 2> /dev/null | head -1)
+done
+
+# Stop the remaining solvers as soon as one bit gives a counterexample
+if [ -n "$failed_bit" ]; then
+    for pid in $(jobs -p); do
+        pkill -P "$pid" 2> /dev/null
+        kill "$pid" 2> /dev/null
+    done
+    wait 2> /dev/null
+fi
+split_ms=$(( $(now_ms) - start ))
+
+errors=$(grep -l "ERROR\|LIMIT" "${split_dir}"/*.verdict 2> /dev/null | wc -l)
+if [ -n "$failed_bit" ]; then
+    bit=${failed_bit##*_bit}
+    echo "[+] VERIFICATION FAILED for bit ${bit%.verdict} (counterexample in ${failed_bit%.verdict}.log): the variable is a CRV"
+elif [ "$errors" -ne 0 ]; then
+    echo "[!] ${errors} variants did not finish, $(grep -l LIMIT "${split_dir}"/*.verdict 2> /dev/null | wc -l) of them on a resource limit (see ${split_dir}/*.log)"
+else
+    echo "[+] VERIFICATION SUCCESSFUL for all ${variants} bits (${first_bit}..$((bits - 1))): the variable is a non-CRV"
+fi
+echo "split run (${workers} workers):  ${split_ms} ms"
+
+if [ "${SPLIT_COMPARE}" = "1" ]; then
+    start=$(now_ms)
+    cbmc "$cbmc_ready_file" -I "$(pwd)" "${cbmc_flags[@]}" > "${split_dir}/symbolic.log" 2>&1
+    echo "symbolic run (1 process):  $(( $(now_ms) - start )) ms"
+fi
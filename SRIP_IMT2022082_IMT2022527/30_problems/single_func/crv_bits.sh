@@ -0,0 +1,25 @@
+#!/bin/bash
+
+##Bit positions of the SEU models of a *_cbmc_ready.c file, used by automate_split_bits.sh and crv_fuzz.sh (source it, do not run it).
+##instrument_seu calls the simulate_seu_main/simulate_seu_site variant of simulate_seu.h that matches the width of the variable,
+##so the bits worth pinning or drawing are those of the widest variant in the file. The legacy simulate_seu_main only flips bits 1..5.
+
+# seu_bit_range <cbmc_ready_file>: prints '<first> <last>', the lowest and highest bit any SEU model of the file can flip
+seu_bit_range() {
+    local file=$1 first=1 last=-1 model width
+    for model in $(grep -o 'simulate_seu_\(main\|site\)\(_[a-z0-9]*\)\? *(' "$file" | tr -d ' (' | sort -u); do
+        case "$model" in
+            simulate_seu_main)				width=6 ;;
+            *_bool)					width=1 ;;
+            *_u8)					width=8 ;;
+            *_i16)					width=16 ;;
+            simulate_seu_site|*_i32|*_f32)		width=32 ;;
+            *)						width=64 ;;
+        esac
+        [ "$model" != "simulate_seu_main" ] && first=0
+        [ $((width - 1)) -gt "$last" ] && last=$((width - 1))
+    done
+    # No recognised call: every bit of the widest model
+    [ "$last" -lt 0 ] && first=0 last=63
+    echo "$first $last"
+}
@@ -0,0 +1,62 @@
+#!/bin/bash
+
+##Content-addressed artifact cache shared by automate_create_files.sh and automate_split_bits.sh (source it, do not run it).
+##Every stage output is stored under ${CRV_CACHE_DIR}/<stage>/<key>, where the key hashes everything the output depends on:
+##the preprocessed source, functions, variables, tool versions and flags. CRV_CACHE=0 disables the cache.
+
+CRV_CACHE_DIR="${CRV_CACHE_DIR:-${HOME}/.cache/crv-seu}"	#Root of the cache, one sub-directory per stage.
+CRV_CACHE_STATS="${CRV_CACHE_STATS:-}"				#File collecting '<stage> hit|miss <bytes>' lines for the end-of-run report.
+
+# Prints the key of a stage from its inputs; arguments starting with @ are files, hashed by content
+cache_key() {
+    local part
+    for part in "$@"; do
+        if [ "${part:0:1}" = "@" ]; then
+            sha256sum < "${part:1}"
+        else
+            echo "$part"
+        fi
+    done | sha256sum | cut -d ' ' -f 1
+}
+
+# Preprocessed source (so that comment or header-only edits are seen the way the tools see them), or the raw file if gcc -E fails
+cache_preprocessed() {
+    local source_file=$1 preprocessed_file=$2
+    gcc -E -P "$source_file" -I . > "$preprocessed_file" 2> /dev/null || cp "$source_file" "$preprocessed_file"
+}
+
+cache_record() {
+    [ -n "$CRV_CACHE_STATS" ] && echo "$1 $2 $3" >> "$CRV_CACHE_STATS"
+}
+
+# Copies the cached output of a stage to <output_file>; fails (and records a miss) when it is not cached yet
+cache_fetch() {
+    local stage=$1 key=$2 output_file=$3
+    local entry="${CRV_CACHE_DIR}/${stage}/${key}"
+    if [ "${CRV_CACHE}" != "0" ] && [ -f "$entry" ]; then
+        cp "$entry" "$output_file"
+        cache_record "$stage" hit "$(stat -c %s "$entry")"
+        return 0
+    fi
+    cache_record "$stage" miss 0
+    return 1
+}
+
+# Stores <output_file> as the output of a stage; written to a temporary name first so concurrent jobs never read a partial entry
+cache_store() {
+    local stage=$1 key=$2 output_file=$3
+    [ "${CRV_CACHE}" = "0" ] || [ ! -s "$output_file" ] && return 0
+    mkdir -p "${CRV_CACHE_DIR}/${stage}"
+    cp "$output_file" "${CRV_CACHE_DIR}/${stage}/${key}.$$" && mv "${CRV_CACHE_DIR}/${stage}/${key}.$$" "${CRV_CACHE_DIR}/${stage}/${key}"
+}
+
+# Prints hit/miss counts per stage and the bytes served from the cache
+cache_report() {
+    [ -n "$CRV_CACHE_STATS" ] && [ -s "$CRV_CACHE_STATS" ] || return 0
+    echo "[+] Cache (${CRV_CACHE_DIR}):"
+    awk '{ stages[$1]; if ($2 == "hit") { hits[$1]++; bytes += $3 } else misses[$1]++ }
+         END {
+             for (s in stages) printf "    %-12s %4d hits %4d misses\n", s, hits[s], misses[s]
+             printf "    bytes saved  %d\n", bytes
+         }' "$CRV_CACHE_STATS"
+}
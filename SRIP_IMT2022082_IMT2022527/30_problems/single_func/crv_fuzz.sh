@@ -0,0 +1,72 @@
+#!/bin/bash
+
+##Native fuzzing pre-filter used by automate_create_files.sh (source it, do not run it).
+##Before CBMC, the combined file is compiled natively with fuzz/crv_fuzz.h and the fuzz/crv_fuzz.c driver, which runs random (input, bit)
+##trials of the harness, drawing the bit among those the SEU models of the file can flip (see crv_bits.sh). A candidate whose assertion fails in a trial is a CRV: its witness becomes its replay file (see crv_replay.sh)
+##and counts once the native replay reproduces it. CBMC only runs for the candidates left, to prove them non-CRV. CRV_FUZZ=0 skips the stage.
+##CRV_FUZZ_ENGINE=libfuzzer fuzzes coverage-guided instead: the harness is linked with the fuzz/crv_libfuzzer.c entry point under
+##clang -fsanitize=fuzzer, which decodes every fuzzer input into the bit, the site and the nondet inputs and crashes on a divergence.
+
+CRV_FUZZ_TRIALS="${CRV_FUZZ_TRIALS:-4000000}"		#Random trials per combined file, shared by the workers.
+CRV_FUZZ_SECONDS="${CRV_FUZZ_SECONDS:-20}"		#Wall-clock limit of one fuzzing run.
+CRV_FUZZ_WORKERS="${CRV_FUZZ_WORKERS:-1}"		#Worker processes of one fuzzing run; the candidates and batch jobs already run in parallel.
+CRV_FUZZ_ENGINE="${CRV_FUZZ_ENGINE:-random}"		#random (fuzz/crv_fuzz.c) or libfuzzer (fuzz/crv_libfuzzer.c).
+CRV_FUZZ_CC="${CRV_FUZZ_CC:-clang}"			#Compiler of the libfuzzer engine, e.g. afl-clang-fast for AFL++.
+
+# fuzz_build <c_file> <binary>: the harness of a combined file under the fuzzing driver, with the bit and site drawn per trial
+fuzz_build() {
+    local c_file=$1 binary=$2 dir=$(dirname "${BASH_SOURCE[0]}")/fuzz first_bit last_bit
+    read -r first_bit last_bit < <(seu_bit_range "$c_file")
+    local bits=(-D CRV_FUZZ_BIT_FIRST="$first_bit" -D CRV_FUZZ_BIT_LAST="$last_bit")
+    if [ "$CRV_FUZZ_ENGINE" = "libfuzzer" ]; then
+        "$CRV_FUZZ_CC" -O1 -g -w -fsanitize=fuzzer -include "${dir}/crv_fuzz.h" "${bits[@]}" -D CRV_HARNESS=crv_fuzz_harness -D CRV_REENTRANT \
+            -D 'SEU_FIXED_BIT=crv_fuzz_bit()' -D 'SEU_FIXED_SITE=crv_fuzz_site()' "$c_file" "${dir}/crv_libfuzzer.c" -o "$binary" -lm
+        return
+    fi
+    "$replay_cc" -O2 -w -include "${dir}/crv_fuzz.h" "${bits[@]}" -D CRV_HARNESS=crv_fuzz_harness \
+        -D 'SEU_FIXED_BIT=crv_fuzz_bit()' -D 'SEU_FIXED_SITE=crv_fuzz_site()' "$c_file" "${dir}/crv_fuzz.c" -o "$binary" -lm
+}
+
+# fuzz_libfuzzer <binary> <c_file> <witness_file>: a libFuzzer run of <binary> in CRV_FUZZ_WORKERS jobs that survive the
+# divergences. The corpus <c_file>_corpus is kept for the next run of the same file, the log is <c_file>_libfuzzer.log
+fuzz_libfuzzer() {
+    local binary=$1 c_file=$2 witness_file=$3
+    local corpus="${c_file%.c}_corpus" log_file="${c_file%.c}_libfuzzer.log"
+    mkdir -p "$corpus"
+    rm -f "$witness_file"
+    CRV_FUZZ_WITNESS="$witness_file" "$binary" -fork="$CRV_FUZZ_WORKERS" -ignore_crashes=1 -max_total_time="$CRV_FUZZ_SECONDS" \
+        -close_fd_mask=1 -artifact_prefix="${c_file%.c}_" "$corpus" > "$log_file" 2>&1
+    local executions=$(grep -o '^#[0-9]*' "$log_file" | tail -1 | tr -d '#')
+    echo "# trials ${executions:-0} engine libfuzzer workers ${CRV_FUZZ_WORKERS}" >> "$witness_file"
+}
+
+# fuzz_run <c_file> <witness_file>: fuzzes the harness of a combined file, leaving the witnesses and trial counts in <witness_file>
+fuzz_run() {
+    local c_file=$1 witness_file=$2
+    local binary="$(dirname "$c_file")/$(basename "${c_file%.c}")_fuzz"
+    fuzz_build "$c_file" "$binary" || return 1
+    if [ "$CRV_FUZZ_ENGINE" = "libfuzzer" ]; then
+        fuzz_libfuzzer "$binary" "$c_file" "$witness_file"
+    else
+        "$binary" "$witness_file" "$CRV_FUZZ_TRIALS" "$CRV_FUZZ_SECONDS" "$CRV_FUZZ_WORKERS"
+    fi
+    rm -f "$binary"
+    echo "[+] $(basename "$c_file"): $(sed -n -e 's/^# trials \([0-9]*\) rejected \([0-9]*\) crashes \([0-9]*\).*/\1 trials (\2 rejected, \3 crashed)/p' \
+        -e 's/^# trials \([0-9]*\) engine \([a-z]*\).*/\1 \2 executions/p' "$witness_file"), $(grep -c '^# CRV witness: ' "$witness_file") witnesses"
+    return 0
+}
+
+# fuzz_witness <witness_file> <variable> <replay_file>: the first witness of <variable> as a replay file; fails when there is none
+fuzz_witness() {
+    local witness_file=$1 variable=$2 replay_file=$3
+    grep -q "^# CRV witness: ${variable} is a CRV " "$witness_file" || return 1
+    {
+        echo "# CRV replay of ${variable}, fuzz witness"
+        awk -v head="# CRV witness: ${variable} is a CRV " 'index($0, head) == 1 { if (done) exit; on = done = 1; next } /^# / { on = 0 } on' "$witness_file"
+    } > "$replay_file"
+}
+
+# fuzz_trials <witness_file>: the number of trials of a fuzzing run
+fuzz_trials() {
+    sed -n 's/^# trials \([0-9]*\) .*/\1/p' "$1"
+}
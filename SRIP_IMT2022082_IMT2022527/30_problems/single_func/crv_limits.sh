@@ -0,0 +1,106 @@
+#!/bin/bash
+
+##Resource governor for CBMC runs, used by automate_create_files.sh and automate_split_bits.sh (source it, do not run it).
+##Every run gets a wall-clock limit (timeout) and a memory limit, an address-space rlimit (ulimit -v) or, with CRV_CGROUP=1, a cgroup
+##MemoryMax through systemd-run. cbmc_governed retries a run that hit a limit with each smaller --unwind bound of CRV_UNWIND_FALLBACK
+##and leaves 'CRV-LIMIT:' lines ahead of the final CBMC output, so the candidate is recorded as bounded instead of lost.
+##With CRV_PORTFOLIO set, each of those runs races several solver backends (see crv_portfolio.sh).
+
+CRV_CBMC_TIMEOUT="${CRV_CBMC_TIMEOUT:-900}"		#Wall-clock seconds per CBMC run, 0 for no limit.
+CRV_CBMC_MEMORY="${CRV_CBMC_MEMORY:-8192}"		#Megabytes per CBMC run, 0 for no limit.
+CRV_UNWIND_FALLBACK="${CRV_UNWIND_FALLBACK:-5 2 1}"	#Smaller --unwind bounds tried in order after a limit; they bound the loops inside the entry function and its callees, 1 keeping one iteration of each.
+
+# run_limited <log_file> <command> [args...]: the command's status, 124 when it ran out of time
+run_limited() {
+    local log_file=$1
+    shift
+    local wrapper=()
+    if [ "${CRV_CGROUP}" = "1" ] && [ "$CRV_CBMC_MEMORY" != "0" ] && command -v systemd-run > /dev/null; then
+        # A cgroup limits the resident set of the whole process tree rather than its address space
+        wrapper=(systemd-run --user --scope --quiet -p "MemoryMax=${CRV_CBMC_MEMORY}M" -p MemorySwapMax=0)
+    fi
+    (
+        [ ${#wrapper[@]} -eq 0 ] && [ "$CRV_CBMC_MEMORY" != "0" ] && ulimit -v $(( CRV_CBMC_MEMORY * 1024 ))
+        if [ "$CRV_CBMC_TIMEOUT" != "0" ]; then
+            exec "${wrapper[@]}" timeout -k 10 "$CRV_CBMC_TIMEOUT" "$@"
+        else
+            exec "${wrapper[@]}" "$@"
+        fi
+    ) > "$log_file" 2>&1
+}
+
+# time, memory or nothing, from the status and the log of a limited run
+limit_hit() {
+    local status=$1 log_file=$2
+    if grep -qi "out of memory\|bad_alloc\|cannot allocate memory" "$log_file"; then
+        echo "memory"
+    elif [ "$status" = "124" ]; then
+        echo "time"
+    elif [ "$status" = "137" ]; then
+        # SIGKILL: the cgroup OOM killer, or timeout -k when CBMC ignored the first signal
+        [ "${CRV_CGROUP}" = "1" ] && echo "memory" || echo "time"
+    fi
+}
+
+# Value of the --unwind flag in a list of CBMC flags
+unwind_of() {
+    local previous="" flag
+    for flag in "$@"; do
+        [ "$previous" = "--unwind" ] && echo "$flag"
+        previous=$flag
+    done
+}
+
+# CBMC flags with --unwind <bound> and every --unwindset bound capped at it; unwinding assertions are dropped, as they would fail at any smaller bound
+bounded_flags() {
+    local bound=$1 previous="" flag
+    shift
+    for flag in "$@"; do
+        case "$previous" in
+            --unwind) ;;
+            --unwindset) echo "$flag" | tr ',' '\n' | awk -F ':' -v b="$bound" '{ k = $NF; sub(/:[^:]*$/, ""); printf "%s%s:%d", (NR > 1 ? "," : ""), $0, (k < b ? k : b) } END { printf "\n" }' ;;
+            *)
+                case "$flag" in
+                    --unwind|--unwinding-assertions) ;;
+                    *) echo "$flag" ;;
+                esac
+                ;;
+        esac
+        previous=$flag
+    done
+    echo "--unwind"
+    echo "$bound"
+}
+
+# cbmc_governed <c_file> <log_file> <profile stack> <cbmc flags...>: CBMC under the limits, falling back to smaller bounds.
+# A FAILURE at a smaller bound is still a real counterexample; a SUCCESS only holds up to that bound
+cbmc_governed() {
+    local c_file=$1 log_file=$2 stack=$3
+    shift 3
+    local flags=("$@") notes="" unwind=$(unwind_of "$@") bound limit status start
+    for bound in "" $CRV_UNWIND_FALLBACK; do
+        if [ -n "$bound" ]; then
+            [ -n "$unwind" ] && [ "$bound" -ge "$unwind" ] && continue
+            mapfile -t flags < <(bounded_flags "$bound" "$@")
+            unwind=$bound
+        fi
+        start=$(now_ms)
+        if [ -n "$CRV_PORTFOLIO" ]; then
+            cbmc_portfolio "$log_file" "$c_file" "${flags[@]}"
+        else
+            run_limited "$log_file" cbmc "$c_file" "${flags[@]}"
+        fi
+        status=$?
+        limit=$(limit_hit "$status" "$log_file")
+        [ -z "$limit" ] && break
+        profile_sample "${stack};limit;${limit}" "$(( $(now_ms) - start ))"
+        notes+="CRV-LIMIT: ${limit} limit at --unwind ${unwind:-none}"$'\n'
+        echo "[!] $(basename "$c_file"): CBMC hit the ${limit} limit at --unwind ${unwind:-none}"
+    done
+    [ -z "$limit" ] && profile_cbmc "$stack" "$(( $(now_ms) - start ))" "$log_file"
+    if [ -n "$notes" ]; then
+        { printf "%s" "$notes"; [ -z "$limit" ] && echo "CRV-BOUND: --unwind ${unwind}"; cat "$log_file"; } > "${log_file}.$$"
+        mv "${log_file}.$$" "$log_file"
+    fi
+    return "$status"
+}
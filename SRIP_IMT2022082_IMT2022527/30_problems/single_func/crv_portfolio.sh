@@ -0,0 +1,77 @@
+#!/bin/bash
+
+##Solver portfolio for CBMC runs, used through cbmc_governed in crv_limits.sh (source it, do not run it).
+##With CRV_PORTFOLIO set, every CBMC run starts once per backend, all at the same time and each under the limits of crv_limits.sh;
+##the first definitive answer wins, the other runs are killed, and the winner is recorded (crv_query.sh backends shows the wins).
+##CRV_PORTFOLIO is a '|'-separated list of '<name>=<extra cbmc flags>', e.g. 'minisat=|kissat=--external-sat-solver kissat|z3=--z3',
+##or 'auto' for MiniSAT plus every solver found on the PATH.
+
+CRV_PORTFOLIO="${CRV_PORTFOLIO:-}"		#Backends raced on every CBMC run; empty runs the default backend alone.
+
+# The 'auto' portfolio: CBMC's built-in MiniSAT, external DIMACS SAT solvers and the SMT2 backends of the installed solvers
+portfolio_detect() {
+    local entries="minisat=" solver
+    for solver in kissat cadical glucose; do
+        command -v "$solver" > /dev/null && entries+="|${solver}=--external-sat-solver ${solver}"
+    done
+    command -v z3 > /dev/null && entries+="|z3=--z3"
+    command -v cvc5 > /dev/null && entries+="|cvc5=--cvc5"
+    command -v yices-smt2 > /dev/null && entries+="|yices=--yices"
+    command -v boolector > /dev/null && entries+="|boolector=--boolector"
+    echo "$entries"
+}
+
+[ "$CRV_PORTFOLIO" = "auto" ] && CRV_PORTFOLIO=$(portfolio_detect)
+
+# cbmc_portfolio <log_file> <c_file> <cbmc flags...>: the status of the winning run (124 when every backend ran out of a limit),
+# whose log, headed by 'CRV-BACKEND: <name>', becomes <log_file>
+cbmc_portfolio() {
+    local log_file=$1 c_file=$2
+    shift 2
+    local entries entry names=() pids=() i winner="" remaining
+    IFS='|' read -ra entries <<< "$CRV_PORTFOLIO"
+    for entry in "${entries[@]}"; do
+        names+=("${entry%%=*}")
+        rm -f "${log_file}.${entry%%=*}.status"
+        (
+            run_limited "${log_file}.${entry%%=*}" cbmc "$c_file" "$@" ${entry#*=}
+            echo $? > "${log_file}.${entry%%=*}.status"
+        ) &
+        pids+=($!)
+    done
+
+    remaining=${#pids[@]}
+    while [ -z "$winner" ] && [ "$remaining" -gt 0 ]; do
+        wait -n
+        remaining=$((remaining - 1))
+        for i in "${!names[@]}"; do
+            if [ -f "${log_file}.${names[$i]}.status" ] && grep -q "VERIFICATION \(SUCCESSFUL\|FAILED\)" "${log_file}.${names[$i]}"; then
+                winner=$i
+                break
+            fi
+        done
+    done
+
+    # timeout passes the TERM on to the CBMC it runs
+    for i in "${!pids[@]}"; do
+        [ "$i" = "$winner" ] && continue
+        pkill -P "${pids[$i]}" 2> /dev/null
+        kill "${pids[$i]}" 2> /dev/null
+    done
+    wait "${pids[@]}" 2> /dev/null
+
+    local status=124
+    if [ -n "$winner" ]; then
+        status=$(cat "${log_file}.${names[$winner]}.status")
+        { echo "CRV-BACKEND: ${names[$winner]}"; cat "${log_file}.${names[$winner]}"; } > "$log_file"
+        echo "[+] $(basename "$c_file"): ${names[$winner]} answered first among ${names[*]}"
+    else
+        # No definitive answer: keep the log of the last backend, whose limit or error cbmc_governed reports
+        cp "${log_file}.${names[-1]}" "$log_file"
+        status=$(cat "${log_file}.${names[-1]}.status" 2> /dev/null || echo 124)
+    fi
+    for i in "${!names[@]}"; do
+        rm -f "${log_file}.${names[$i]}" "${log_file}.${names[$i]}.status"
+    done
+    return "$status"
+}
@@ -0,0 +1,87 @@
+#!/bin/bash
+
+##Stage profiler used by automate_create_files.sh and automate_file_runs.sh (source it, do not run it).
+##Every timed stage appends collapsed-stack lines '<candidate>;<stage>[;<substage>...] <microseconds of self time>' to ${CRV_PROFILE_FILE},
+##the input format of flamegraph tools (flamegraph.pl, inferno, speedscope); instrument_seu --profile and the CBMC 'Runtime ...' lines give the substages.
+##profile_report prints the stages with the most cumulative time. CRV_PROFILE=0 disables the profiler.
+
+CRV_PROFILE_FILE="${CRV_PROFILE_FILE:-}"	#Collapsed stacks of a run; a caller may share it to profile a whole batch.
+CRV_PROFILE_TOP="${CRV_PROFILE_TOP:-15}"	#Number of stages in the report.
+cbmc_profile_flags="--verbosity 8"		#Makes CBMC print its per-phase 'Runtime ...' lines; not part of the CBMC cache key, the verdict does not depend on it.
+
+profile_enabled() {
+    [ "${CRV_PROFILE}" != "0" ] && [ -n "$CRV_PROFILE_FILE" ]
+}
+
+# instrument_seu flag writing its internal stage times to <folded_file>, when the profiler is on
+profile_flag() {
+    profile_enabled && echo "--profile $1"
+}
+
+# profile_sample <stack> <milliseconds>
+profile_sample() {
+    profile_enabled || return 0
+    echo "$1 $(( $2 > 0 ? $2 * 1000 : 0 ))" >> "$CRV_PROFILE_FILE"
+}
+
+# profile_nested <stack> <milliseconds> <folded_file>: the stacks a tool wrote about itself go under <stack>,
+# and whatever the tool did not account for (process start, I/O) is the self time of <stack>
+profile_nested() {
+    local stack=$1 ms=$2 folded_file=$3
+    profile_enabled || return 0
+    local inner=0
+    if [ -s "$folded_file" ]; then
+        inner=$(awk '{ sum += $NF } END { printf "%d\n", sum }' "$folded_file")
+        awk -v stack="$stack" '{ print stack ";" $0 }' "$folded_file" >> "$CRV_PROFILE_FILE"
+    fi
+    local self=$(( ms * 1000 - inner ))
+    echo "${stack} $(( self > 0 ? self : 0 ))" >> "$CRV_PROFILE_FILE"
+}
+
+# profile_cbmc <stack> <milliseconds> <log_file>: CBMC phases from its 'Runtime Symex: 0.012s' lines;
+# the decision procedure covers Convert SSA and Solver, so those two are nested under it
+profile_cbmc() {
+    local stack=$1 ms=$2 log_file=$3
+    profile_enabled || return 0
+    local folded_file=$(mktemp)
+    awk '/^Runtime [^:]*: [0-9.]+s/ {
+             name = $0; sub(/^Runtime /, "", name); sub(/:.*/, "", name)
+             time = $0; sub(/^[^:]*: /, "", time); sub(/s.*/, "", time)
+             us[name] += time * 1000000
+         }
+         END {
+             # Reading a missing entry would create it, hence the "in" tests
+             inner = ("Convert SSA" in us ? us["Convert SSA"] : 0) + ("Solver" in us ? us["Solver"] : 0)
+             nested = ("decision procedure" in us) && inner > 0
+             for (name in us) {
+                 frame = tolower(name); gsub(/[ -]/, "_", frame)
+                 if (nested && (name == "Convert SSA" || name == "Solver")) frame = "decision_procedure;" frame
+                 time = us[name]
+                 if (nested && name == "decision procedure") time -= inner
+                 printf "%s %d\n", frame, (time > 0 ? time : 0)
+             }
+         }' "$log_file" > "$folded_file" 2> /dev/null
+    profile_nested "$stack" "$ms" "$folded_file"
+    rm -f "$folded_file"
+}
+
+# Prints the ${CRV_PROFILE_TOP} stages with the most cumulative time over all candidates of <folded_file>
+profile_report() {
+    local folded_file=$1
+    profile_enabled && [ -s "$folded_file" ] || return 0
+    echo "[+] Top stages by cumulative time (collapsed stacks for flamegraph tools in ${folded_file}):"
+    # The first frame names the candidate, the rest is the stage path; a stage includes the time of its substages
+    awk 'match($0, / [0-9]+$/) {
+             time = substr($0, RSTART + 1); n = split(substr($0, 1, RSTART - 1), frame, ";")
+             candidates[frame[1]]; total += time
+             path = ""
+             for (k = 2; k <= n; k++) { path = (k == 2 ? frame[k] : path ";" frame[k]); cumulative[path] += time }
+         }
+         END {
+             for (path in cumulative) printf "%d\t%s\t%.1f\n", cumulative[path], path, (total > 0 ? cumulative[path] * 100 / total : 0)
+             for (c in candidates) count++
+             printf "%d\t<all stages of %d jobs and candidates>\t100.0\n", total, count
+         }' "$folded_file" |
+        sort -t $'\t' -k 1,1 -nr | head -n "$(( CRV_PROFILE_TOP + 1 ))" |
+        awk -F '\t' '{ printf "    %10.1f ms %5.1f%%  %s\n", $1 / 1000, $3, $2 }'
+}
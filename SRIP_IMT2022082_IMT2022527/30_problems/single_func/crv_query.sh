@@ -0,0 +1,99 @@
+#!/bin/bash
+
+##Queries the results store written by automate_create_files.sh (one JSON record per candidate, see crv_results.sh). Needs jq.
+##Usage: ./crv_query.sh runs                          one line per run: records, verdicts, total time per stage
+##       ./crv_query.sh summary [run]                 verdict and stage times of every candidate (default: latest run)
+##       ./crv_query.sh stages [run]                  total, mean and max time per stage, and the share of cached stages
+##       ./crv_query.sh slowest [n] [run]             the n candidates with the longest CBMC time
+##       ./crv_query.sh compare <old_run> <new_run>   CBMC time and solver size per candidate across two runs, verdict changes first
+##       ./crv_query.sh backends [file]               solver wins and mean CBMC time per controller and backend over all runs (portfolio mode), without cached CBMC logs
+##CRV_RESULTS selects another store.
+
+source "$(dirname "$0")/crv_results.sh"
+
+if [ ! -s "$CRV_RESULTS" ]; then
+    echo "[!] No results in ${CRV_RESULTS}"
+    exit 1
+fi
+
+command=${1:-runs}
+
+# Lines up tab-separated columns
+align() {
+    awk -F '\t' '{ for (i = 1; i <= NF; i++) { cell[NR, i] = $i; if (length($i) > width[i]) width[i] = length($i) } cols[NR] = NF }
+                 END { for (r = 1; r <= NR; r++) { for (i = 1; i <= cols[r]; i++) printf "%-*s  ", width[i], cell[r, i]; printf "\n" } }'
+}
+
+# Run ID given on the command line, or the most recent one in the store
+run_or_latest() {
+    if [ -n "$1" ]; then
+        echo "$1"
+    else
+        tail -1 "$CRV_RESULTS" | jq -r '.run'
+    fi
+}
+
+case "$command" in
+    runs)
+        jq -rs 'group_by(.run)[]
+                | "\(.[0].run)  \(length) candidates  \(map(select(.verdict == "CRV")) | length) CRV  \(map(select(.verdict == "non-CRV")) | length) non-CRV  \(map(select(.verdict == "bounded")) | length) bounded  \(map(select(.verdict == "ERROR")) | length) errors"
+                  + "  slice \(map(.times_ms.slice) | add) ms  instrument \(map(.times_ms.instrument) | add) ms  cbmc \(map(.times_ms.cbmc) | add) ms"' \
+            "$CRV_RESULTS"
+        ;;
+    summary)
+        run=$(run_or_latest "$2")
+        printf "%-8s %-40s %-30s %8s %8s %8s %8s %10s %4s\n" "verdict" "file" "variable" "slice" "prep" "instr" "cbmc" "clauses" "bit"
+        jq -r --arg run "$run" 'select(.run == $run)
+               | [.verdict, .file, .variable, .times_ms.slice, .times_ms.preprocess, .times_ms.instrument, .times_ms.cbmc, .cbmc.clauses, .witness_bit]
+               | map(tostring) | @tsv' "$CRV_RESULTS" |
+            while IFS=$'\t' read -r verdict file variable slice prep instr cbmc clauses bit; do
+                printf "%-8s %-40s %-30s %8s %8s %8s %8s %10s %4s\n" "$verdict" "$file" "$variable" "$slice" "$prep" "$instr" "$cbmc" "$clauses" "$bit"
+            done
+        ;;
+    stages)
+        run=$(run_or_latest "$2")
+        jq -rs --arg run "$run" 'map(select(.run == $run)) as $records
+                | ["slice", "preprocess", "instrument", "fuzz", "cbmc"][] as $stage
+                | ($records | map(.times_ms[$stage] // 0)) as $times
+                | ($records | map(select(.cached | index($stage))) | length) as $cached
+                | "\($stage)\t\($times | add) ms total\t\(($times | add) / ($times | length) | floor) ms mean\t\($times | max) ms max\t\($cached)/\($times | length) cached"' \
+            "$CRV_RESULTS" | align
+        ;;
+    slowest)
+        n=${2:-10}
+        run=$(run_or_latest "$3")
+        jq -rs --arg run "$run" --argjson n "$n" 'map(select(.run == $run)) | sort_by(-.times_ms.cbmc) | .[:$n][]
+                | "\(.times_ms.cbmc) ms\t\(.file)\t\(.variable)\t\(.verdict)\t\(.cbmc.variables) variables\t\(.cbmc.clauses) clauses"' \
+            "$CRV_RESULTS" | align
+        ;;
+    compare)
+        if [ $# -lt 3 ]; then
+            echo "Usage: $0 compare <old_run> <new_run>"
+            exit 1
+        fi
+        # Ratios above 1 are slowdowns of the new run; a changed verdict usually means a tool or model change, not noise
+        jq -rs --arg old "$2" --arg new "$3" '
+                (map(select(.run == $old)) | map({key: "\(.file)|\(.variable)", value: .}) | from_entries) as $a
+                | map(select(.run == $new))
+                | map(. as $r | $a["\($r.file)|\($r.variable)"] as $o | select($o != null)
+                      | {changed: ($o.verdict != $r.verdict), ratio: (if $o.times_ms.cbmc > 0 then $r.times_ms.cbmc / $o.times_ms.cbmc else null end),
+                         line: "\($r.file)\t\($r.variable)\t\($o.verdict) -> \($r.verdict)\t\($o.times_ms.cbmc) -> \($r.times_ms.cbmc) ms\t\($o.cbmc.clauses) -> \($r.cbmc.clauses) clauses\t\($o.tools.cbmc) -> \($r.tools.cbmc)"})
+                | sort_by([(.changed | not), -(.ratio // 0)])[]
+                | "\(if .changed then "VERDICT" elif (.ratio // 0) > 1.2 then "SLOWER" elif .ratio != null and .ratio < 0.8 then "FASTER" else "same" end)\t\(.ratio // "-" | if type == "number" then (. * 100 | floor) / 100 else . end)x\t\(.line)"' \
+            "$CRV_RESULTS" | align
+        ;;
+    backends)
+        # Every record names the backend that answered; in portfolio mode that is the race winner, so the counts are wins.
+        # Logs restored from the cache are no race, and their fetch time is no CBMC time, so they are left out
+        jq -rs --arg file "${2:-}" 'map(select(.cbmc.backend != null and (.cbmc.backend | type) == "string" and ($file == "" or .file == $file)
+                                        and ((.cached // []) | index("cbmc") | not)))
+                | group_by(.file)[] | . as $records
+                | group_by(.cbmc.backend) | sort_by(-length)[]
+                | "\(.[0].file)\t\(.[0].cbmc.backend)\t\(length)/\($records | length) wins\t\(map(.times_ms.cbmc) | add / length | floor) ms mean cbmc"' \
+            "$CRV_RESULTS" | align
+        ;;
+    *)
+        sed -n 's/^##//p' "$0"
+        exit 1
+        ;;
+esac
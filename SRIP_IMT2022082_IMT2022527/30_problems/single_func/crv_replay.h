@@ -0,0 +1,120 @@
+#ifndef CRV_REPLAY_H
+#define CRV_REPLAY_H
+
+// Native replay of a CBMC counterexample (see crv_replay.sh): gcc -include crv_replay.h ahead of a combined
+// _cbmc_ready.c file makes every nondet_ call of the harness return the next 'input' value of a replay file,
+// in the order of the trace, and turns the CPROVER built-ins into run-time checks. The bit and the site of
+// the SEU are pinned at compile time with -D SEU_FIXED_BIT=<n> and -D SEU_FIXED_SITE=<n> (see simulate_seu.h).
+// The replay file is ${CRV_REPLAY_INPUT} or the CRV_REPLAY_FILE it was built with; the exit status is 10 when a
+// CRV assertion fails (the counterexample reproduces), 0 when all hold and 2 when the replay does not fit.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#ifndef CRV_REPLAY_FILE
+#define CRV_REPLAY_FILE "crv.replay"
+#endif
+
+static FILE *crv_replay_in = NULL;
+static int crv_replay_failed = 0;
+static int crv_replay_misfit = 0;
+
+static void crv_replay_status(void) {
+    fflush(NULL);
+    _exit(crv_replay_misfit ? 2 : crv_replay_failed ? 10 : 0);
+}
+
+static void crv_replay_does_not_fit(void) {
+    crv_replay_misfit = 1;
+    exit(2);
+}
+
+__attribute__((constructor)) static void crv_replay_open(void) {
+    const char *path = getenv("CRV_REPLAY_INPUT");
+    if(path == NULL || *path == '\0')
+        path = CRV_REPLAY_FILE;
+    crv_replay_in = fopen(path, "r");
+    if(crv_replay_in == NULL) {
+        perror(path);
+        exit(2);
+    }
+    printf("[replay] %s\n", path);
+    atexit(crv_replay_status);
+}
+
+// Bits of the next 'input <name> <binary> <value>' line; data gets the value as CBMC printed it
+static unsigned long long crv_replay_next(const char *type, char *data, size_t size) {
+    char line[4096], name[1024], bits[256];
+    int value_at = 0;
+    while(fgets(line, sizeof line, crv_replay_in) != NULL) {
+        if(sscanf(line, "input %1023s %255s %n", name, bits, &value_at) < 2 || value_at == 0)
+            continue;
+        line[strcspn(line, "\n")] = '\0';
+        snprintf(data, size, "%s", line + value_at);
+        printf("[replay] %s = %s\n", name, data);
+        // Wider values (long double) keep their low 64 bits; their data is parsed instead
+        size_t len = strlen(bits);
+        return strtoull(len > 64 ? bits + len - 64 : bits, NULL, 2);
+    }
+    fprintf(stderr, "[replay] no input left for nondet_%s: the replay file does not fit this harness\n", type);
+    crv_replay_does_not_fit();
+    return 0;
+}
+
+#define CRV_REPLAY_INT(name, type) \
+    type nondet_##name(void) { char data[256]; return (type)crv_replay_next(#name, data, sizeof data); }
+
+CRV_REPLAY_INT(char, char)
+CRV_REPLAY_INT(schar, signed char)
+CRV_REPLAY_INT(uchar, unsigned char)
+CRV_REPLAY_INT(short, short)
+CRV_REPLAY_INT(ushort, unsigned short)
+CRV_REPLAY_INT(int, int)
+CRV_REPLAY_INT(uint, unsigned int)
+CRV_REPLAY_INT(long, long)
+CRV_REPLAY_INT(ulong, unsigned long)
+CRV_REPLAY_INT(longlong, long long)
+CRV_REPLAY_INT(ulonglong, unsigned long long)
+
+_Bool nondet_bool(void) {
+    char data[256];
+    return crv_replay_next("bool", data, sizeof data) != 0;
+}
+
+float nondet_float(void) {
+    char data[256];
+    union { unsigned int bits; float value; } v;
+    v.bits = (unsigned int)crv_replay_next("float", data, sizeof data);
+    return v.value;
+}
+
+double nondet_double(void) {
+    char data[256];
+    union { unsigned long long bits; double value; } v;
+    v.bits = crv_replay_next("double", data, sizeof data);
+    return v.value;
+}
+
+long double nondet_longdouble(void) {
+    char data[256];
+    crv_replay_next("longdouble", data, sizeof data);
+    return strtold(data, NULL);
+}
+
+#define __CPROVER_assume(cond) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "[replay] assumption %s does not hold: the replay file does not fit this harness\n", #cond); \
+            crv_replay_does_not_fit(); \
+        } \
+    } while(0)
+
+#define __CPROVER_assert(cond, description) do { \
+        int crv_replay_holds = (cond) != 0; \
+        printf("[replay] %s: %s\n", description, crv_replay_holds ? "SUCCESS" : "FAILURE"); \
+        crv_replay_failed |= !crv_replay_holds; \
+    } while(0)
+
+#endif // CRV_REPLAY_H
@@ -0,0 +1,84 @@
+#!/bin/bash
+
+##Counterexample replay used by automate_create_files.sh (source it, do not run it).
+##For every CRV, CBMC runs once more on the failed assertion alone with --json-ui --trace, and jq takes the nondet inputs of the harness,
+##the bit and site of the SEU and the place it hit out of that trace into a <record>.replay file. gcc then builds <record>_replay, which
+##re-executes the original and the instrumented copy natively with those values (see crv_replay.h); CRV_REPLAY_INPUT=<file> feeds it another replay.
+##CRV_REPLAY=0 skips the stage.
+
+replay_cc="${CC:-gcc}"				#Compiler of the replay binaries.
+
+# Id of the failed assertion of <variable> in a CBMC log, e.g. main.assertion.2
+replay_property() {
+    local log_file=$1 variable=$2
+    sed -n "s/^\[\([^]]*\)\] .* ${variable} is a CRV: FAILURE.*/\1/p" "$log_file" | head -1
+}
+
+# Path of the native replay binary of a record, runnable as it is
+replay_binary() {
+    local record_file=$1
+    echo "$(dirname "$record_file")/$(basename "${record_file%.c}")_replay"
+}
+
+# replay_extract <json_trace> <property> <replay_file>: the values of the failed <property> in its JSON trace, one line each:
+#   input <name> <binary> <value>	a nondet value of the harness, in the order of the nondet_ calls, i.e. the assignments of main
+#					before the first crv_saved_/crv_out (the uninitialized crv_any_ structs are not replayed)
+#   bit <n>				last bit_pos or seu_selected_bit, the flipped bit
+#   site <n>				seu_selected_site (instrument_seu --select-site)
+#   flip <function>:<line>		call of simulate_seu_main*/simulate_seu_site* that injected the SEU
+replay_extract() {
+    local json_file=$1 property=$2 replay_file=$3
+    jq -r --arg property "$property" '
+        .[] | select(has("result")) | .result[] | select(.property == $property) | .trace // [] |
+        (reduce (.[] | select(.stepType == "assignment" and .sourceLocation.function == "main")) as $step
+            ({done: false, names: [], values: {}};
+             if .done then .
+             elif ($step.lhs | test("^crv_(saved|out)_")) then .done = true
+             elif ($step.lhs | test("^crv_any_")) or $step.value.binary == null or $step.value.name == "pointer" then .
+             else (if .values | has($step.lhs) then . else .names += [$step.lhs] end) | .values[$step.lhs] = $step.value
+             end)
+         | .names[] as $name | .values[$name] | "input \($name) \(.binary) \(.data)"),
+        ([.[] | select(.stepType == "assignment" and (.lhs == "bit_pos" or .lhs == "seu_selected_bit"))] | last | values | "bit \(.value.data)"),
+        ([.[] | select(.stepType == "assignment" and .lhs == "seu_selected_site")] | last | values | "site \(.value.data)"),
+        (reduce .[] as $step ({call: null, flip: null};
+             if $step.stepType == "function-call" and ($step.function.identifier | test("^simulate_seu_(main|site)"))
+             then .call = $step.sourceLocation
+             elif $step.stepType == "assignment" and ($step.lhs | test("seu_count$")) and $step.value.data != "0" and .call != null
+             then .flip = .call
+             else . end)
+         | .flip | values | "flip \(.function):\(.line)")
+    ' "$json_file" >> "$replay_file"
+}
+
+# replay_build <c_file> <replay_file> <binary>: the native replay binary of a combined file, with the bit and site of <replay_file>
+replay_build() {
+    local c_file=$1 replay_file=$2 binary=$3
+    local bit=$(sed -n 's/^bit //p' "$replay_file") site=$(sed -n 's/^site //p' "$replay_file")
+    "$replay_cc" -O2 -w -include "$(dirname "${BASH_SOURCE[0]}")/crv_replay.h" -D CRV_REPLAY_FILE="\"${replay_file}\"" \
+        ${bit:+-D SEU_FIXED_BIT=${bit}} ${site:+-D SEU_FIXED_SITE=${site}} "$c_file" -o "$binary" -lm
+}
+
+# replay_counterexample <c_file> <log_file> <variable> <record_file> <cbmc flags...>: writes <record>.replay and builds <record>_replay.
+# The trace run is bounded like the run that found the counterexample and restricted to its assertion
+replay_counterexample() {
+    local c_file=$1 log_file=$2 variable=$3 record_file=$4
+    shift 4
+    local property=$(replay_property "$log_file" "$variable")
+    local replay_file="${record_file%.c}.replay" json_file="${record_file%.c}_trace.json"
+    [ -n "$property" ] || return 1
+    local bound=$(sed -n 's/^CRV-BOUND: --unwind //p' "$log_file" | tail -1) flags=("$@")
+    [ -n "$bound" ] && mapfile -t flags < <(bounded_flags "$bound" "$@")
+
+    run_limited "$json_file" cbmc "$c_file" "${flags[@]}" --trace --json-ui --property "$property"
+    echo "# CRV replay of ${variable} in $(basename "$c_file"), ${property}" > "$replay_file"
+    if ! replay_extract "$json_file" "$property" "$replay_file" || ! grep -q "^input " "$replay_file"; then
+        echo "[!] ${variable}: no counterexample trace for ${property} in ${json_file}"
+        return 1
+    fi
+    rm -f "$json_file"
+    if replay_build "$c_file" "$replay_file" "$(replay_binary "$record_file")"; then
+        echo "[+] ${variable}: counterexample in ${replay_file}, native replay $(replay_binary "$record_file")"
+    else
+        echo "[!] ${variable}: the native replay of ${c_file} does not compile"
+    fi
+}
@@ -0,0 +1,60 @@
+#!/bin/bash
+
+##Structured results store used by automate_create_files.sh (source it, do not run it).
+##Every checked candidate gets one JSON record, written next to its _cbmc_ready.c file and appended as one line to ${CRV_RESULTS},
+##so crv_query.sh can aggregate records across runs and tool versions.
+
+CRV_RESULTS="${CRV_RESULTS:-$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)/crv_results.jsonl}"	#One JSON record per line, kept across runs.
+CRV_RUN_ID="${CRV_RUN_ID:-$(date +%Y%m%d-%H%M%S)-$$}"						#Groups the records of one run (shared by a whole batch).
+
+now_ms() {
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# Value of a solver statistic in a CBMC log, or null
+cbmc_stat() {
+    local log_file=$1 pattern=$2
+    local value=$(sed -n "s/${pattern}/\\1/p" "$log_file" 2> /dev/null | tail -1)
+    echo "${value:-null}"
+}
+
+# Bit position of the counterexample: the last bit_pos (simulate_seu_main*) or seu_selected_bit (--select-site) in the trace,
+# or the bit of a replay file (see crv_replay.sh)
+witness_bit() {
+    local log_file=$1
+    local bit=$(sed -n 's/^ *\(bit_pos\|seu_selected_bit\)=\(-\?[0-9][0-9]*\).*/\2/p; s/^bit \([0-9][0-9]*\)$/\1/p' "$log_file" 2> /dev/null | tail -1)
+    echo "${bit:-null}"
+}
+
+# Backend that produced a CBMC log as a JSON string: the portfolio winner (see crv_portfolio.sh), or the solver CBMC names, or null
+log_backend() {
+    local log_file=$1
+    local backend=$(sed -n 's/^CRV-BACKEND: //p' "$log_file" 2> /dev/null | tail -1)
+    [ -n "$backend" ] || backend=$(sed -n 's/^Solving with \([^ ]*\).*/\1/p; s/^Running SMT2 .* using \([^ ]*\).*/\1/p' "$log_file" 2> /dev/null | tail -1)
+    [ -n "$backend" ] && echo "\"$(echo "$backend" | tr 'A-Z' 'a-z')\"" || echo "null"
+}
+
+# write_result <output_file> <variable> <verdict> <slice_ms> <preprocess_ms> <instrument_ms> <cbmc_ms> <cached stages> <log_file> [<reason>]
+write_result() {
+    local output_file=$1 variable=$2 verdict=$3 slice_ms=$4 preprocess_ms=$5 instrument_ms=$6 cbmc_ms=$7 cached=$8 log_file=$9 reason=${10:-cbmc}
+    local record
+    record=$(printf '{"run": "%s", "date": "%s", "file": "%s", "function": "%s", "output": "%s", "variable": "%s", "verdict": "%s", "reason": "%s", "slice_fingerprint": "%s", ' \
+        "$CRV_RUN_ID" "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$(basename "$source_file")" "$entry_function" "$entry_variable" "$variable" "$verdict" "$reason" "$slice_fingerprint"
+    printf '"times_ms": {"slice": %s, "preprocess": %s, "instrument": %s, "fuzz": %s, "cbmc": %s}, "cached": [%s], ' \
+        "$slice_ms" "$preprocess_ms" "$instrument_ms" "${fuzz_ms:-0}" "$cbmc_ms" "$cached"
+    printf '"cbmc": {"variables": %s, "clauses": %s, "steps": %s, "decision_procedure_s": %s, "backend": %s}, "witness_bit": %s, ' \
+        "$(cbmc_stat "$log_file" '^\([0-9][0-9]*\) variables, [0-9][0-9]* clauses.*')" \
+        "$(cbmc_stat "$log_file" '^[0-9][0-9]* variables, \([0-9][0-9]*\) clauses.*')" \
+        "$(cbmc_stat "$log_file" '^size of program expression: \([0-9][0-9]*\) steps.*')" \
+        "$(cbmc_stat "$log_file" '^Runtime decision procedure: \([0-9.][0-9.]*\)s.*')" \
+        "$(log_backend "$log_file")" \
+        "$(witness_bit "$log_file")"
+    # The harness flags hold the prior-state mode (--state initial|nondet), which changes what a verdict means
+    local harness_flags="${instrument_flags[*]}"
+    printf '"tools": {"frama_c": "%s", "cbmc": "%s", "instrument_seu": "%s", "cbmc_flags": "%s", "unwindset": "%s", "harness_flags": "%s"}}' \
+        "$frama_c_version" "$cbmc_version" "$instrument_seu_version" "$cbmc_flags" "$unwindset" "${harness_flags//\"/\\\"}")
+
+    echo "$record" > "${output_file%.c}.json"
+    # A single short append is atomic, so concurrent jobs can share the store
+    echo "$record" >> "$CRV_RESULTS"
+}
@@ -0,0 +1,294 @@
+// Driver of the native CRV fuzzer (see crv_fuzz.h and crv_fuzz.sh):
+//   <binary> <witness_file> <trials> <seconds> <workers>
+// forks <workers> processes that share <trials> random trials of the harness for at most <seconds>. Every trial starts
+// from the globals of program start (the data and bss segments are copied back), draws its inputs from a xoshiro256**
+// PRNG biased towards small and boundary values, and is rejected when an assumption fails or the controller crashes.
+// The SEU bit is drawn from CRV_FUZZ_BIT_FIRST..CRV_FUZZ_BIT_LAST, the bits the SEU models of the file can flip (crv_bits.sh);
+// a copy whose model is narrower rejects the trial through its own assumption, as the native replay of the witness would.
+// The first failing trial of every assertion is appended to <witness_file> as '# CRV witness: <description>' followed
+// by the 'input', 'bit' and 'site' lines of a crv_replay.sh replay file. The exit status is 10 when a worker saw every
+// assertion of the harness fail, 0 otherwise.
+
+#include <setjmp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "crv_fuzz_inputs.h"
+
+int crv_fuzz_harness(void);
+
+// Start and end of the writable data of the executable (GNU toolchain)
+extern char __data_start[], _end[];
+
+#define CRV_FUZZ_MAX_ASSERTIONS 64
+
+// Everything a trial must not reset lives on the heap: the data segment is copied back before every trial
+struct crv_fuzz_state {
+    uint64_t prng[4];
+    sigjmp_buf trial;
+    volatile sig_atomic_t in_trial, stop;
+    int witness_fd;
+    unsigned long long trials, rejected, crashes;
+    int bit, site;
+    struct crv_fuzz_draws inputs;
+    int assertions;
+    const char *description[CRV_FUZZ_MAX_ASSERTIONS];
+    int failed[CRV_FUZZ_MAX_ASSERTIONS];
+    char *snapshot;
+    size_t snapshot_size;
+};
+
+static struct crv_fuzz_state *fz;
+
+static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t crv_fuzz_next(void) {
+    uint64_t *s = fz->prng;
+    uint64_t result = rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+    s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+    s[2] ^= t; s[3] = rotl(s[3], 45);
+    return result;
+}
+
+static void crv_fuzz_seed(uint64_t seed) {
+    for(int i = 0; i < 4; i++) {
+        // splitmix64
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        fz->prng[i] = z ^ (z >> 31);
+    }
+}
+
+static struct crv_fuzz_draws *crv_fuzz_draws(void) {
+    return &fz->inputs;
+}
+
+// An integer of <width> bits: small values and boundaries often, so that narrow assumptions and guards are hit
+static unsigned long long crv_fuzz_integer(int width, int is_signed) {
+    unsigned long long mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    unsigned long long max = is_signed ? mask >> 1 : mask, min = is_signed ? ~max & mask : 0;
+    uint64_t r = crv_fuzz_next();
+    switch(r & 7) {
+    case 0: case 1: case 2:
+        return (unsigned long long)((long long)((r >> 8) % 67) - (is_signed ? 2 : 0)) & mask;
+    case 3: {
+        unsigned long long special[] = { 0, 1, mask, min, max, min + 1, max - 1, 100, 1000 };
+        return special[(r >> 8) % (sizeof special / sizeof special[0])] & mask;
+    }
+    default:
+        return crv_fuzz_next() & mask;
+    }
+}
+
+static double crv_fuzz_real(void) {
+    uint64_t r = crv_fuzz_next();
+    switch(r & 7) {
+    case 0: case 1:
+        return (double)((long long)((r >> 8) % 67) - 2);
+    case 2: {
+        double special[] = { 0.0, -0.0, 1.0, -1.0, 0.5, 1e-9, 1e9, -1e9 };
+        return special[(r >> 8) % (sizeof special / sizeof special[0])];
+    }
+    default:
+        // Uniform in [-1, 1) scaled by 2^-4 .. 2^16
+        return ((double)(crv_fuzz_next() >> 11) / 4503599627370496.0 - 1.0) * (double)(1 << ((r >> 8) % 21)) / 16.0;
+    }
+}
+
+static unsigned long long crv_fuzz_real_bits(int width) {
+    if(width == 32) {
+        union { float value; unsigned int bits; } v = { (float)crv_fuzz_real() };
+        return v.bits;
+    }
+    union { double value; unsigned long long bits; } v = { crv_fuzz_real() };
+    return v.bits;
+}
+
+// One bit and one site per trial, however often simulate_seu.h asks for them
+int crv_fuzz_bit(void) {
+    if(fz->bit < 0)
+        fz->bit = CRV_FUZZ_BIT_FIRST + (int)(crv_fuzz_next() % (CRV_FUZZ_BIT_LAST - CRV_FUZZ_BIT_FIRST + 1));
+    return fz->bit;
+}
+
+int crv_fuzz_site(void) {
+    if(fz->site < 0)
+        fz->site = (int)crv_fuzz_integer(16, 0) % 64;
+    return fz->site;
+}
+
+void crv_fuzz_reject(void) {
+    siglongjmp(fz->trial, 1);
+}
+
+static void crv_fuzz_write_witness(int index) {
+    char origin[64];
+    size_t length;
+    snprintf(origin, sizeof origin, "trial %llu of worker %d", fz->trials, (int)getpid());
+    char *block = crv_fuzz_witness(fz->description[index], origin, fz->bit, fz->site, &length);
+    if(block != NULL) {
+        write(fz->witness_fd, block, length);
+        free(block);
+    }
+}
+
+void crv_fuzz_check(int holds, const char *description) {
+    int index = 0;
+    while(index < fz->assertions && strcmp(fz->description[index], description) != 0)
+        index++;
+    if(index == fz->assertions && index < CRV_FUZZ_MAX_ASSERTIONS) {
+        fz->description[index] = description;
+        fz->failed[index] = 0;
+        fz->assertions++;
+    }
+    if(!holds && index < fz->assertions && !fz->failed[index]) {
+        fz->failed[index] = 1;
+        crv_fuzz_write_witness(index);
+    }
+}
+
+static void crv_fuzz_signal(int signal) {
+    if(signal == SIGALRM || signal == SIGTERM)
+        fz->stop = 1;
+    if(fz->in_trial)
+        siglongjmp(fz->trial, signal == SIGALRM || signal == SIGTERM ? 3 : 2);
+    if(signal != SIGALRM && signal != SIGTERM)
+        _exit(1);
+}
+
+static int crv_fuzz_all_failed(void) {
+    for(int i = 0; i < fz->assertions; i++)
+        if(!fz->failed[i])
+            return 0;
+    return fz->assertions > 0;
+}
+
+static int crv_fuzz_worker(int worker, unsigned long long trials, int seconds, const char *witness_file) {
+    char path[4096];
+    snprintf(path, sizeof path, "%s.%d", witness_file, worker);
+    fz->witness_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fz->witness_fd < 0)
+        return 1;
+    crv_fuzz_seed(((uint64_t)time(NULL) << 20) ^ ((uint64_t)getpid() << 8) ^ (uint64_t)worker);
+
+    // The controllers log every step: their output would dominate the run time
+    int null_fd = open("/dev/null", O_WRONLY);
+    if(null_fd >= 0)
+        dup2(null_fd, STDOUT_FILENO);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof action);
+    action.sa_handler = crv_fuzz_signal;
+    action.sa_flags = SA_NODEFER;
+    int signals[] = { SIGSEGV, SIGFPE, SIGBUS, SIGILL, SIGALRM, SIGTERM };
+    for(size_t i = 0; i < sizeof signals / sizeof signals[0]; i++)
+        sigaction(signals[i], &action, NULL);
+    struct itimerval limit = { { 0, 0 }, { seconds, 0 } };
+    if(seconds > 0)
+        setitimer(ITIMER_REAL, &limit, NULL);
+
+    fz->snapshot_size = (size_t)(_end - __data_start);
+    fz->snapshot = malloc(fz->snapshot_size);
+    memcpy(fz->snapshot, __data_start, fz->snapshot_size);
+
+    while(!fz->stop && fz->trials < trials && !crv_fuzz_all_failed()) {
+        memcpy(__data_start, fz->snapshot, fz->snapshot_size);
+        fz->inputs.count = 0;
+        fz->bit = fz->site = -1;
+        fz->trials++;
+        int outcome = sigsetjmp(fz->trial, 1);
+        if(outcome == 0) {
+            fz->in_trial = 1;
+            crv_fuzz_harness();
+            fz->in_trial = 0;
+        } else {
+            fz->in_trial = 0;
+            if(outcome == 1)
+                fz->rejected++;
+            else if(outcome == 2)
+                fz->crashes++;
+            else
+                fz->trials--;
+        }
+    }
+
+    char line[256];
+    int failed = 0;
+    for(int i = 0; i < fz->assertions; i++)
+        failed += fz->failed[i];
+    write(fz->witness_fd, line, snprintf(line, sizeof line, "# trials %llu rejected %llu crashes %llu assertions %d failed %d\n",
+                                         fz->trials, fz->rejected, fz->crashes, fz->assertions, failed));
+    close(fz->witness_fd);
+    return crv_fuzz_all_failed() ? 10 : 0;
+}
+
+int main(int argc, char **argv) {
+    if(argc != 5) {
+        fprintf(stderr, "Usage: %s <witness_file> <trials> <seconds> <workers>\n", argv[0]);
+        return 1;
+    }
+    const char *witness_file = argv[1];
+    unsigned long long trials = strtoull(argv[2], NULL, 10);
+    int seconds = atoi(argv[3]), workers = atoi(argv[4]);
+    if(workers < 1)
+        workers = 1;
+
+    fz = calloc(1, sizeof *fz);
+    pid_t *pids = calloc(workers, sizeof *pids);
+    for(int w = 0; w < workers; w++) {
+        pids[w] = fork();
+        if(pids[w] == 0)
+            _exit(crv_fuzz_worker(w, (trials + workers - 1) / workers, seconds, witness_file));
+    }
+
+    // The first worker that saw every assertion fail ends the run
+    int status, found = 0;
+    for(int running = workers; running > 0; running--) {
+        pid_t pid = wait(&status);
+        if(pid < 0)
+            break;
+        if(!found && WIFEXITED(status) && WEXITSTATUS(status) == 10) {
+            found = 1;
+            for(int w = 0; w < workers; w++)
+                if(pids[w] != pid)
+                    kill(pids[w], SIGTERM);
+        }
+    }
+
+    // Witnesses of all workers, then their statistics
+    FILE *out = fopen(witness_file, "w");
+    if(out == NULL)
+        return 1;
+    unsigned long long total[3] = { 0, 0, 0 };
+    for(int w = 0; w < workers; w++) {
+        char path[4096], line[4096];
+        snprintf(path, sizeof path, "%s.%d", witness_file, w);
+        FILE *in = fopen(path, "r");
+        if(in == NULL)
+            continue;
+        while(fgets(line, sizeof line, in) != NULL) {
+            unsigned long long t, r, c;
+            if(sscanf(line, "# trials %llu rejected %llu crashes %llu", &t, &r, &c) == 3) {
+                total[0] += t; total[1] += r; total[2] += c;
+            } else {
+                fputs(line, out);
+            }
+        }
+        fclose(in);
+        unlink(path);
+    }
+    fprintf(out, "# trials %llu rejected %llu crashes %llu workers %d\n", total[0], total[1], total[2], workers);
+    fclose(out);
+    return found ? 10 : 0;
+}
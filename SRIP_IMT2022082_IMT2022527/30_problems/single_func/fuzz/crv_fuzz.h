@@ -0,0 +1,25 @@
+#ifndef CRV_FUZZ_H
+#define CRV_FUZZ_H
+
+// Native fuzzing of a combined _cbmc_ready.c file (see crv_fuzz.sh): gcc -include crv_fuzz.h -D CRV_HARNESS=crv_fuzz_harness,
+// linked with the fuzz/crv_fuzz.c driver, runs the harness once per random trial. The nondet_ functions draw from a fast PRNG,
+// a failed __CPROVER_assume rejects the trial and a failed __CPROVER_assert is a CRV witness. With
+// -D SEU_FIXED_BIT=crv_fuzz_bit() and -D SEU_FIXED_SITE=crv_fuzz_site() the bit and the site of the SEU are drawn once per trial.
+
+// Range of the SEU bit, -D'd by crv_fuzz.sh from the models of the combined file
+#ifndef CRV_FUZZ_BIT_FIRST
+#define CRV_FUZZ_BIT_FIRST 0
+#endif
+#ifndef CRV_FUZZ_BIT_LAST
+#define CRV_FUZZ_BIT_LAST 63
+#endif
+
+int crv_fuzz_bit(void);
+int crv_fuzz_site(void);
+void crv_fuzz_reject(void);
+void crv_fuzz_check(int holds, const char *description);
+
+#define __CPROVER_assume(cond) do { if(!(cond)) crv_fuzz_reject(); } while(0)
+#define __CPROVER_assert(cond, description) crv_fuzz_check((cond) != 0, description)
+
+#endif // CRV_FUZZ_H
@@ -0,0 +1,120 @@
+#ifndef CRV_FUZZ_INPUTS_H
+#define CRV_FUZZ_INPUTS_H
+
+// The nondet_ functions and the witness format shared by the two fuzzing entry points, crv_fuzz.c (random trials) and
+// crv_libfuzzer.c (coverage-guided); each includes this file once. The entry point defines where a value comes from,
+//   static unsigned long long crv_fuzz_integer(int width, int is_signed);	the bits of an integer of <width> bits
+//   static unsigned long long crv_fuzz_real_bits(int width);			the bits of a float (32) or double (64)
+//   static struct crv_fuzz_draws *crv_fuzz_draws(void);				the values of the current run, for its witness
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crv_fuzz.h"
+
+#define CRV_FUZZ_MAX_DRAWS 4096
+
+struct crv_fuzz_draw {
+    const char *name;
+    int width;
+    unsigned long long bits;
+    char value[48];
+};
+
+struct crv_fuzz_draws {
+    int count;
+    struct crv_fuzz_draw draw[CRV_FUZZ_MAX_DRAWS];
+};
+
+static unsigned long long crv_fuzz_integer(int width, int is_signed);
+static unsigned long long crv_fuzz_real_bits(int width);
+static struct crv_fuzz_draws *crv_fuzz_draws(void);
+
+static struct crv_fuzz_draw *crv_fuzz_record(const char *name, int width, unsigned long long bits) {
+    struct crv_fuzz_draws *draws = crv_fuzz_draws();
+    if(draws->count == CRV_FUZZ_MAX_DRAWS)
+        crv_fuzz_reject();
+    struct crv_fuzz_draw *d = &draws->draw[draws->count++];
+    d->name = name;
+    d->width = width;
+    d->bits = bits;
+    return d;
+}
+
+#define CRV_FUZZ_INT(name, type, is_signed) \
+    type nondet_##name(void) { \
+        unsigned long long bits = crv_fuzz_integer(8 * sizeof(type), is_signed); \
+        type value = (type)bits; \
+        struct crv_fuzz_draw *d = crv_fuzz_record("nondet_" #name, 8 * sizeof(type), bits); \
+        if(is_signed) snprintf(d->value, sizeof d->value, "%lld", (long long)value); \
+        else snprintf(d->value, sizeof d->value, "%llu", (unsigned long long)value); \
+        return value; \
+    }
+
+CRV_FUZZ_INT(char, char, ((char)-1 < 0))
+CRV_FUZZ_INT(schar, signed char, 1)
+CRV_FUZZ_INT(uchar, unsigned char, 0)
+CRV_FUZZ_INT(short, short, 1)
+CRV_FUZZ_INT(ushort, unsigned short, 0)
+CRV_FUZZ_INT(int, int, 1)
+CRV_FUZZ_INT(uint, unsigned int, 0)
+CRV_FUZZ_INT(long, long, 1)
+CRV_FUZZ_INT(ulong, unsigned long, 0)
+CRV_FUZZ_INT(longlong, long long, 1)
+CRV_FUZZ_INT(ulonglong, unsigned long long, 0)
+
+_Bool nondet_bool(void) {
+    _Bool value = crv_fuzz_integer(1, 0) & 1;
+    snprintf(crv_fuzz_record("nondet_bool", 1, value)->value, sizeof crv_fuzz_draws()->draw[0].value, "%s", value ? "TRUE" : "FALSE");
+    return value;
+}
+
+float nondet_float(void) {
+    union { float value; unsigned int bits; } v;
+    v.bits = (unsigned int)crv_fuzz_real_bits(32);
+    snprintf(crv_fuzz_record("nondet_float", 32, v.bits)->value, sizeof crv_fuzz_draws()->draw[0].value, "%.9g", v.value);
+    return v.value;
+}
+
+double nondet_double(void) {
+    union { double value; unsigned long long bits; } v;
+    v.bits = crv_fuzz_real_bits(64);
+    snprintf(crv_fuzz_record("nondet_double", 64, v.bits)->value, sizeof crv_fuzz_draws()->draw[0].value, "%.17g", v.value);
+    return v.value;
+}
+
+long double nondet_longdouble(void) {
+    union { double value; unsigned long long bits; } v;
+    v.bits = crv_fuzz_real_bits(64);
+    // The replay parses the value of a long double, so its bits are those of the double it came from
+    snprintf(crv_fuzz_record("nondet_longdouble", 64, v.bits)->value, sizeof crv_fuzz_draws()->draw[0].value, "%.17g", v.value);
+    return v.value;
+}
+
+// '# CRV witness: <description> (<origin>)' and the 'input', 'bit' and 'site' lines of a crv_replay.sh replay file, in one
+// malloc'd block that the caller writes with a single write() and frees; a negative bit or site is left out
+static char *crv_fuzz_witness(const char *description, const char *origin, int bit, int site, size_t *length) {
+    const struct crv_fuzz_draws *draws = crv_fuzz_draws();
+    size_t size = 256 + strlen(description) + strlen(origin) + (size_t)draws->count * 192, n;
+    char *block = malloc(size);
+    if(block == NULL)
+        return NULL;
+    n = snprintf(block, size, "# CRV witness: %s (%s)\n", description, origin);
+    for(int i = 0; i < draws->count; i++) {
+        const struct crv_fuzz_draw *d = &draws->draw[i];
+        char bits[65];
+        for(int b = 0; b < d->width; b++)
+            bits[b] = (d->bits >> (d->width - 1 - b)) & 1 ? '1' : '0';
+        bits[d->width] = '\0';
+        n += snprintf(block + n, size - n, "input %s %s %s\n", d->name, bits, d->value);
+    }
+    if(bit >= 0)
+        n += snprintf(block + n, size - n, "bit %d\n", bit);
+    if(site >= 0)
+        n += snprintf(block + n, size - n, "site %d\n", site);
+    *length = n;
+    return block;
+}
+
+#endif // CRV_FUZZ_INPUTS_H
@@ -0,0 +1,160 @@
+/* Coverage-guided entry point of the CRV harness (see crv_fuzz.h and crv_fuzz.sh, CRV_FUZZ_ENGINE=libfuzzer):
+ *   clang -fsanitize=fuzzer -include crv_fuzz.h -D CRV_HARNESS=crv_fuzz_harness -D CRV_REENTRANT
+ *         -D 'SEU_FIXED_BIT=crv_fuzz_bit()' -D 'SEU_FIXED_SITE=crv_fuzz_site()' <combined.c> crv_libfuzzer.c
+ * LLVMFuzzerTestOneInput decodes one fuzzer input into one run of the harness: byte 0 picks the flipped bit among
+ * CRV_FUZZ_BIT_FIRST..CRV_FUZZ_BIT_LAST, byte 1 the fault site, and every nondet_ call (parameters, volatile globals,
+ * prior state) takes the next bytes of its width, little-endian, or zeros once the input is used up. A failed
+ * __CPROVER_assume drops the input; a failed __CPROVER_assert, i.e. phi ^ phi_prime, is a crash: its witness
+ * (crv_fuzz_inputs.h) goes to stderr and is appended to $CRV_FUZZ_WITNESS, then abort().
+ * An assertion that already has a witness in $CRV_FUZZ_WITNESS is not reported again, so a -fork run with
+ * -ignore_crashes=1 goes on looking for the other candidates. AFL++ takes the same binary (afl-clang-fast -fsanitize=fuzzer),
+ * and -D CRV_FUZZ_STANDALONE adds a main that runs the inputs in its file arguments (or stdin), e.g. to turn a
+ * libFuzzer crash-* artifact back into its witness with gcc alone. */
+
+#include <fcntl.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "crv_fuzz_inputs.h"
+
+int crv_fuzz_harness(void);
+
+#define CRV_FUZZ_MAX_ASSERTIONS 64
+
+static const uint8_t *crv_input;
+static size_t crv_input_size, crv_input_used;
+static jmp_buf crv_run;
+static int crv_bit, crv_site;
+static struct crv_fuzz_draws crv_inputs;
+static const char *crv_witness_file;
+static int crv_known;
+static char *crv_known_description[CRV_FUZZ_MAX_ASSERTIONS];
+
+// The next <bytes> bytes of the input as a little-endian number, zero past its end
+static unsigned long long crv_fuzz_bytes(int bytes) {
+    unsigned long long bits = 0;
+    for(int i = 0; i < bytes; i++, crv_input_used++)
+        if(crv_input_used < crv_input_size)
+            bits |= (unsigned long long)crv_input[crv_input_used] << (8 * i);
+    return bits;
+}
+
+static struct crv_fuzz_draws *crv_fuzz_draws(void) {
+    return &crv_inputs;
+}
+
+static unsigned long long crv_fuzz_integer(int width, int is_signed) {
+    return crv_fuzz_bytes((width + 7) / 8);
+}
+
+static unsigned long long crv_fuzz_real_bits(int width) {
+    return crv_fuzz_bytes(width / 8);
+}
+
+void crv_fuzz_reject(void) {
+    longjmp(crv_run, 1);
+}
+
+int crv_fuzz_bit(void) {
+    return crv_bit;
+}
+
+int crv_fuzz_site(void) {
+    return crv_site;
+}
+
+static int crv_fuzz_known(const char *description) {
+    for(int i = 0; i < crv_known; i++)
+        if(strcmp(crv_known_description[i], description) == 0)
+            return 1;
+    return 0;
+}
+
+static void crv_fuzz_remember(const char *description) {
+    if(crv_known < CRV_FUZZ_MAX_ASSERTIONS && !crv_fuzz_known(description))
+        crv_known_description[crv_known++] = strdup(description);
+}
+
+// The witness is written with a single write(), so that the jobs of a -fork run do not interleave their blocks
+void crv_fuzz_check(int holds, const char *description) {
+    if(holds || crv_fuzz_known(description))
+        return;
+    char origin[64];
+    size_t length;
+    snprintf(origin, sizeof origin, "libFuzzer input of %zu bytes", crv_input_size);
+    char *block = crv_fuzz_witness(description, origin, crv_bit, crv_site, &length);
+    if(block != NULL) {
+        write(STDERR_FILENO, block, length);
+        int fd = crv_witness_file != NULL ? open(crv_witness_file, O_WRONLY | O_CREAT | O_APPEND, 0644) : -1;
+        if(fd >= 0) {
+            write(fd, block, length);
+            close(fd);
+        }
+        free(block);
+    }
+    crv_fuzz_remember(description);
+    abort();
+}
+
+// The assertions that already have a witness, from earlier jobs or runs
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    crv_witness_file = getenv("CRV_FUZZ_WITNESS");
+    FILE *in = crv_witness_file != NULL ? fopen(crv_witness_file, "r") : NULL;
+    if(in == NULL)
+        return 0;
+    char line[4096];
+    while(fgets(line, sizeof line, in) != NULL) {
+        char *end = strstr(line, " (libFuzzer input of ");
+        if(strncmp(line, "# CRV witness: ", 15) == 0 && end != NULL) {
+            *end = '\0';
+            crv_fuzz_remember(line + 15);
+        }
+    }
+    fclose(in);
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    crv_input = data;
+    crv_input_size = size;
+    crv_input_used = 0;
+    crv_inputs.count = 0;
+    crv_bit = CRV_FUZZ_BIT_FIRST + (int)(crv_fuzz_bytes(1) % (CRV_FUZZ_BIT_LAST - CRV_FUZZ_BIT_FIRST + 1));
+    crv_site = (int)(crv_fuzz_bytes(1) % 64);
+    if(setjmp(crv_run) == 0)
+        crv_fuzz_harness();
+    return 0;
+}
+
+#ifdef CRV_FUZZ_STANDALONE
+static void crv_fuzz_run_file(FILE *in) {
+    size_t size = 0, capacity = 4096;
+    uint8_t *data = malloc(capacity);
+    size_t n;
+    while((n = fread(data + size, 1, capacity - size, in)) > 0)
+        if((size += n) == capacity)
+            data = realloc(data, capacity *= 2);
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+}
+
+int main(int argc, char **argv) {
+    LLVMFuzzerInitialize(&argc, &argv);
+    if(argc < 2)
+        crv_fuzz_run_file(stdin);
+    for(int i = 1; i < argc; i++) {
+        FILE *in = fopen(argv[i], "rb");
+        if(in == NULL) {
+            fprintf(stderr, "[!] Cannot read %s\n", argv[i]);
+            return 1;
+        }
+        crv_fuzz_run_file(in);
+        fclose(in);
+    }
+    return 0;
+}
+#endif
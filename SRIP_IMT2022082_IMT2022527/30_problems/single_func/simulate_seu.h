@@ -7,6 +7,17 @@
 
 int nondet_int();
 
+// Per-bit split mode: compiling with -D SEU_FIXED_BIT=<n> pins every bit position to n, so the
+// variants n = 0..63 together cover the same flips as one symbolic run (see automate_split_bits.sh)
+#ifdef SEU_FIXED_BIT
+
+int nondet_int_range_1_32() {
+    __CPROVER_assume(SEU_FIXED_BIT >= 1 && SEU_FIXED_BIT <= 32);
+    return SEU_FIXED_BIT;
+}
+
+#else
+
 // Function to generate a nondeterministic integer within the range [1, 32]
 int nondet_int_range_1_32() {
     int value = nondet_int() % 32 + 1;
@@ -14,19 +25,186 @@ int nondet_int_range_1_32() {
     return value;
 }
 
+#endif
+
+// Legacy model of simulate_seu_main, kept for files instrumented before the width-specific variants:
+// it only flips bits 1..5 (the mask is assumed to lie in [1, 32]); instrument_seu uses simulate_seu_main_i32
 int simulate_seu(int value, int bit_pos) {
+    __CPROVER_assume(bit_pos >= 0 && bit_pos < 31); // no shift past the width of int
     int mask = 1 << bit_pos;
     __CPROVER_assume(mask >= 1 && mask <= 32);
     return (value ^ mask); // XOR operation for bit flip
 }
 
+// Function to generate a nondeterministic bit position within the range [0, width)
+int nondet_bit_pos(int width) {
+#ifdef SEU_FIXED_BIT
+    int bit_pos = SEU_FIXED_BIT;
+#else
+    int bit_pos = nondet_int();
+#endif
+    __CPROVER_assume(bit_pos >= 0 && bit_pos < width);
+    return bit_pos;
+}
+
+// Number of SEUs introduced so far, shared by all simulate_seu_main variants
+static int seu_count = 0;
+
 // Ensures that an SEU is introduced only once for the variable under investigation
 void simulate_seu_main(int *invest_var) {
-    static int count = 0;
-    if(count == 0) {
+    if(seu_count == 0) {
         int bit_pos = nondet_int_range_1_32();
         *invest_var = simulate_seu(*invest_var, bit_pos);
-        count++;
+        seu_count++;
+    }
+}
+
+// Width-specific variants, chosen by instrument_seu from the type of the variable under investigation
+
+// A bool holds a single bit, so the only upset is a negation
+void simulate_seu_main_bool(bool *invest_var) {
+    if(seu_count == 0) {
+        nondet_bit_pos(1); // keeps the negation out of every split variant but bit 0
+        *invest_var = !*invest_var;
+        seu_count++;
+    }
+}
+
+// char, signed char and unsigned char
+void simulate_seu_main_u8(unsigned char *invest_var) {
+    if(seu_count == 0) {
+        int bit_pos = nondet_bit_pos(8);
+        *invest_var = (unsigned char)(*invest_var ^ (1u << bit_pos));
+        seu_count++;
+    }
+}
+
+// short and unsigned short
+void simulate_seu_main_i16(short *invest_var) {
+    if(seu_count == 0) {
+        int bit_pos = nondet_bit_pos(16);
+        *invest_var = (short)((unsigned short)*invest_var ^ (1u << bit_pos));
+        seu_count++;
+    }
+}
+
+// int, unsigned int, enums, and long / pointers on 32-bit targets: any of the 32 bits
+void simulate_seu_main_i32(int *invest_var) {
+    if(seu_count == 0) {
+        int bit_pos = nondet_bit_pos(32);
+        *invest_var = (int)((unsigned int)*invest_var ^ (1u << bit_pos));
+        seu_count++;
+    }
+}
+
+// long long, and long / pointers on 64-bit targets
+void simulate_seu_main_i64(long long *invest_var) {
+    if(seu_count == 0) {
+        int bit_pos = nondet_bit_pos(64);
+        *invest_var = (long long)((unsigned long long)*invest_var ^ (1ull << bit_pos));
+        seu_count++;
+    }
+}
+
+// Flips a bit of the IEEE-754 single precision representation
+void simulate_seu_main_f32(float *invest_var) {
+    if(seu_count == 0) {
+        union { float value; unsigned int bits; } seu;
+        int bit_pos = nondet_bit_pos(32);
+        seu.value = *invest_var;
+        seu.bits ^= 1u << bit_pos;
+        *invest_var = seu.value;
+        seu_count++;
+    }
+}
+
+// Flips a bit of the IEEE-754 double precision representation
+void simulate_seu_main_f64(double *invest_var) {
+    if(seu_count == 0) {
+        union { double value; unsigned long long bits; } seu;
+        int bit_pos = nondet_bit_pos(64);
+        seu.value = *invest_var;
+        seu.bits ^= 1ull << bit_pos;
+        *invest_var = seu.value;
+        seu_count++;
+    }
+}
+
+// Lets the next instrumented copy of a multi-candidate harness inject its own SEU
+void simulate_seu_reset(void) {
+    seu_count = 0;
+}
+
+// Single-run fault-site selection (instrument_seu --select-site): every injection site has an ID,
+// one site and one bit are chosen nondeterministically on entry and only that site flips, so the
+// counterexample names the site and bit through seu_selected_site and seu_selected_bit.
+// Compiling with -D SEU_FIXED_SITE=<n> pins the site, as SEU_FIXED_BIT pins the bit (see crv_replay.sh)
+int seu_selected_site = -1;
+int seu_selected_bit = -1;
+
+void simulate_seu_select(int num_sites) {
+#ifdef SEU_FIXED_SITE
+    seu_selected_site = SEU_FIXED_SITE;
+#else
+    seu_selected_site = nondet_int();
+#endif
+    __CPROVER_assume(seu_selected_site >= 0 && seu_selected_site < num_sites);
+    seu_selected_bit = nondet_bit_pos(64);
+}
+
+// True the first time the selected site is reached, provided the selected bit fits the variable
+int seu_site_hit(int site, int width) {
+    if(seu_count != 0 || site != seu_selected_site)
+        return 0;
+    __CPROVER_assume(seu_selected_bit < width);
+    seu_count++;
+    return 1;
+}
+
+void simulate_seu_site(int site, int *invest_var) {
+    if(seu_site_hit(site, 32))
+        *invest_var = (int)((unsigned int)*invest_var ^ (1u << seu_selected_bit));
+}
+
+void simulate_seu_site_i32(int site, int *invest_var) {
+    simulate_seu_site(site, invest_var);
+}
+
+void simulate_seu_site_bool(int site, bool *invest_var) {
+    if(seu_site_hit(site, 1))
+        *invest_var = !*invest_var;
+}
+
+void simulate_seu_site_u8(int site, unsigned char *invest_var) {
+    if(seu_site_hit(site, 8))
+        *invest_var = (unsigned char)(*invest_var ^ (1u << seu_selected_bit));
+}
+
+void simulate_seu_site_i16(int site, short *invest_var) {
+    if(seu_site_hit(site, 16))
+        *invest_var = (short)((unsigned short)*invest_var ^ (1u << seu_selected_bit));
+}
+
+void simulate_seu_site_i64(int site, long long *invest_var) {
+    if(seu_site_hit(site, 64))
+        *invest_var = (long long)((unsigned long long)*invest_var ^ (1ull << seu_selected_bit));
+}
+
+void simulate_seu_site_f32(int site, float *invest_var) {
+    if(seu_site_hit(site, 32)) {
+        union { float value; unsigned int bits; } seu;
+        seu.value = *invest_var;
+        seu.bits ^= 1u << seu_selected_bit;
+        *invest_var = seu.value;
+    }
+}
+
+void simulate_seu_site_f64(int site, double *invest_var) {
+    if(seu_site_hit(site, 64)) {
+        union { double value; unsigned long long bits; } seu;
+        seu.value = *invest_var;
+        seu.bits ^= 1ull << seu_selected_bit;
+        *invest_var = seu.value;
     }
 }
 
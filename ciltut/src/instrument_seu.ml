@@ -1,6 +1,8 @@
 open Cil
 open Pretty
 module E = Errormsg
+module IH = Inthash
+module DF = Dataflow
 
 (* Function to check if an expression contains a specific variable *)
 let rec uses_variable (vname : string) (e : exp) : bool =
@@ -23,10 +25,12 @@ let extract_lval_from_lhs (lv : lval) (target_var : string) : lval option =
   | Var vi, _ when vi.vname = target_var -> Some lv
   | _ -> None
 
-(* Extract the first matching lval from expression where variable is used *)
+(* Extract the first lval of the variable from an expression where it is used *)
 let rec extract_matching_lval (vname : string) (e : exp) : lval option =
   match e with
-  | Lval lv -> Some lv
+  | Lval ((Var vi, NoOffset) as lv) when vi.vname = vname -> Some lv
+  | Lval ((_, Field (fi, _)) as lv) when fi.fname = vname -> Some lv
+  | Lval (_, Index (idx, _)) -> extract_matching_lval vname idx
   | BinOp (_, e1, e2, _) ->
       (match extract_matching_lval vname e1 with
        | Some lv -> Some lv
@@ -35,19 +39,82 @@ let rec extract_matching_lval (vname : string) (e : exp) : lval option =
   | CastE (_, e1) -> extract_matching_lval vname e1
   | _ -> None
 
-(* Create the function call simulate_seu_main(&x) dynamically *)
-let create_seu_call (lv : lval) (loc : location) : instr =
-  let seu_fun = findOrCreateFunc dummyFile "simulate_seu_main"
-    (TFun(voidType, Some ["arg", TPtr(intType, []), []], false, [])) in
-  Call (None, Lval (Var seu_fun, NoOffset), [AddrOf lv], loc)
+(* Pick the simulate_seu_main variant (see simulate_seu.h) modelling the real width of a type,
+   as the suffix of the model's name and the type it points to *)
+let seu_variant (t : typ) : string * typ =
+  let int_variant () =
+    match bitsSizeOf t with
+    | 8 -> "_u8", TInt (IUChar, [])
+    | 16 -> "_i16", TInt (IShort, [])
+    | 64 -> "_i64", TInt (ILongLong, [])
+    | _ -> "_i32", intType
+  in
+  match unrollType t with
+  | TInt (IBool, _) -> "_bool", TInt (IBool, [])
+  | TInt _ | TEnum _ | TPtr _ -> int_variant ()
+  | TFloat (FFloat, _) -> "_f32", TFloat (FFloat, [])
+  | TFloat (FDouble, _) -> "_f64", TFloat (FDouble, [])
+  | _ ->
+      E.warn "No width-specific SEU model for %a, treating it as int" d_type t;
+      "_i32", intType
 
-class seuInstrumentationVisitor (target_var : string) = object
+(* Single-run fault-site selection: every injection site gets an ID, the instrumented function
+   picks one site and one bit on entry (simulate_seu_select) and only that site flips *)
+let select_site = ref false
+let site_locations : (int * location) list ref = ref []
+
+(* Create the function call simulate_seu_main(&x), or its variant for the type of x, dynamically.
+   With --select-site it becomes simulate_seu_site(site, &x). *)
+let create_seu_call (lv : lval) (loc : location) (site : int) : instr =
+  let t = typeOfLval lv in
+  let suffix, param_t = seu_variant t in
+  let arg =
+    if typeSig t = typeSig param_t then AddrOf lv
+    else CastE (TPtr (param_t, []), AddrOf lv)
+  in
+  if !select_site then begin
+    site_locations := (site, loc) :: !site_locations;
+    let seu_fun = findOrCreateFunc dummyFile ("simulate_seu_site" ^ suffix)
+      (TFun(voidType, Some ["site", intType, []; "arg", TPtr(param_t, []), []], false, [])) in
+    Call (None, Lval (Var seu_fun, NoOffset), [integer site; arg], loc)
+  end else begin
+    let seu_fun = findOrCreateFunc dummyFile ("simulate_seu_main" ^ suffix)
+      (TFun(voidType, Some ["arg", TPtr(param_t, []), []], false, [])) in
+    Call (None, Lval (Var seu_fun, NoOffset), [arg], loc)
+  end
+
+(* simulate_seu_select(num_sites) as the first statement of fd *)
+let add_site_selection (fd : fundec) (num_sites : int) : unit =
+  let select_fun = findOrCreateFunc dummyFile "simulate_seu_select"
+    (TFun(voidType, Some ["num_sites", intType, []], false, [])) in
+  let loc = match fd.sbody.bstmts with
+    | s :: _ -> get_stmtLoc s.skind
+    | [] -> locUnknown
+  in
+  let call = Call (None, Lval (Var select_fun, NoOffset), [integer num_sites], loc) in
+  fd.sbody.bstmts <- mkStmtOneInstr call :: fd.sbody.bstmts
+
+class seuInstrumentationVisitor (target_var : string) = object(self)
   inherit nopCilVisitor
   val mutable initialized = false
+  val mutable sites = 0
+
+  method sites = sites
+
+  method private seu_call (lv : lval) (loc : location) : instr =
+    sites <- sites + 1;
+    create_seu_call lv loc (sites - 1)
+
+  (* The variable as it appears in e, so that its declared type picks the SEU model *)
+  method private target_lval (e : exp) : lval =
+    match extract_matching_lval target_var e with
+    | Some lv -> lv
+    | None -> Var (makeGlobalVar target_var intType), NoOffset
 
   method vstmt (s : stmt) =
     match s.skind with
     | Instr il ->
+        (* Accumulated in reverse and flipped once, so rewriting stays linear in the instruction count *)
         let new_instrs = ref [] in
         List.iter (fun i ->
           match i with
@@ -63,7 +130,7 @@ class seuInstrumentationVisitor (target_var : string) = object
                    if not initialized && is_constant_rhs then
                      initialized <- true (* Skip first init assignment *)
                    else (
-                     new_instrs := !new_instrs @ [create_seu_call matched_lv loc];
+                     new_instrs := self#seu_call matched_lv loc :: !new_instrs;
                      inserted := true)
                | None -> ());
 
@@ -71,11 +138,11 @@ class seuInstrumentationVisitor (target_var : string) = object
                 match extract_matching_lval target_var rhs with
                 | Some matched_lv ->
                     if not !inserted then
-                      new_instrs := !new_instrs @ [create_seu_call matched_lv loc]
+                      new_instrs := self#seu_call matched_lv loc :: !new_instrs
                 | None -> ()
               );
 
-              new_instrs := !new_instrs @ [i]
+              new_instrs := i :: !new_instrs
 
           | Call (_, _, args, loc) ->
               if List.exists (uses_variable target_var) args then (
@@ -83,51 +150,844 @@ class seuInstrumentationVisitor (target_var : string) = object
                   let arg = List.find (uses_variable target_var) args in
                   match extract_matching_lval target_var arg with
                   | Some matched_lv ->
-                      new_instrs := !new_instrs @ [create_seu_call matched_lv loc]
+                      new_instrs := self#seu_call matched_lv loc :: !new_instrs
                   | None -> ()
                 with Not_found -> ()
               );
-              new_instrs := !new_instrs @ [i]
+              new_instrs := i :: !new_instrs
 
-          | _ -> new_instrs := !new_instrs @ [i]
+          | _ -> new_instrs := i :: !new_instrs
         ) il;
-        ChangeTo (mkStmt (Instr !new_instrs))
+        ChangeTo (mkStmt (Instr (List.rev !new_instrs)))
 
     | If (cond, b1, b2, loc) when uses_variable target_var cond ->
-        let lv = Var (makeGlobalVar target_var intType), NoOffset in
-        let call = mkStmtOneInstr (create_seu_call lv loc) in
+        let lv = self#target_lval cond in
+        let call = mkStmtOneInstr (self#seu_call lv loc) in
         ChangeTo (mkStmt (Block (mkBlock [call; s])))
 
     | Loop (body, loc, _, _) ->
         ChangeDoChildrenPost(s, fun s' -> s')
 
     | Switch (exp, body, cases, loc) when uses_variable target_var exp ->
-        let lv = Var (makeGlobalVar target_var intType), NoOffset in
-        let call = mkStmtOneInstr (create_seu_call lv loc) in
+        let lv = self#target_lval exp in
+        let call = mkStmtOneInstr (self#seu_call lv loc) in
         ChangeTo (mkStmt (Block (mkBlock [call; s])))
 
     | Return (Some e, loc) when uses_variable target_var e ->
         (match extract_matching_lval target_var e with
          | Some matched_lv ->
-             let call = mkStmtOneInstr (create_seu_call matched_lv loc) in
+             let call = mkStmtOneInstr (self#seu_call matched_lv loc) in
              ChangeTo (mkStmt (Block (mkBlock [call; s])))
          | None -> DoChildren)
 
     | _ -> DoChildren
 end
 
+(* Dataflow-driven placement: instead of one injection before every use, inject once right
+   after each definition of the variable that is still live (and once at function entry if
+   the incoming value is live). A flip there is seen by every use of that definition, so each
+   def-use web is covered from its definitions and loops add no extra sites of their own. *)
+
+(* Instruction reads the variable *)
+let instr_uses (vname : string) (i : instr) : bool =
+  match i with
+  | Set (_, e, _) -> uses_variable vname e
+  | Call (_, _, args, _) -> List.exists (uses_variable vname) args
+  | _ -> false
+
+(* Instruction overwrites the whole variable *)
+let instr_defines (vname : string) (i : instr) : bool =
+  match i with
+  | Set ((Var vi, NoOffset), _, _)
+  | Call (Some (Var vi, NoOffset), _, _, _) -> vi.vname = vname
+  | _ -> false
+
+let instr_live_before (vname : string) (i : instr) (live_after : bool) : bool =
+  instr_uses vname i || (live_after && not (instr_defines vname i))
+
+let live_target = ref ""
+let live_at_exit = ref false
+
+(* Liveness of the single target variable, a backwards analysis over CIL's Dataflow *)
+module LiveTargetDF = struct
+  let name = "LiveTarget"
+  let debug = ref false
+  type t = bool
+  let pretty () (live : t) = text (if live then "live" else "dead")
+  let stmtStartData : t IH.t = IH.create 64
+  let funcExitData = false
+
+  let combineStmtStartData (s : stmt) ~(old : t) (now : t) =
+    if old || not now then None else Some true
+
+  let combineSuccessors = (||)
+
+  let doStmt (s : stmt) =
+    match s.skind with
+    | Return (Some e, _) -> DF.Post (fun live -> live || !live_at_exit || uses_variable !live_target e)
+    | Return (None, _) -> DF.Post (fun live -> live || !live_at_exit)
+    | If (e, _, _, _) | Switch (e, _, _, _) -> DF.Post (fun live -> live || uses_variable !live_target e)
+    | _ -> DF.Default
+
+  let doInstr (i : instr) (live : t) = DF.Done (instr_live_before !live_target i live)
+
+  let filterStmt _ _ = true
+end
+
+module LiveTarget = DF.BackwardsDataFlow(LiveTargetDF)
+
+class stmtCollectorClass (acc : stmt list ref) = object
+  inherit nopCilVisitor
+  method vstmt s = acc := s :: !acc; DoChildren
+end
+
+class varFinderClass (vname : string) (found : varinfo option ref) = object
+  inherit nopCilVisitor
+  method vvrbl vi = if vi.vname = vname then found := Some vi; SkipChildren
+end
+
+let find_target_varinfo (fd : fundec) (vname : string) : varinfo option =
+  try Some (List.find (fun vi -> vi.vname = vname) (fd.sformals @ fd.slocals))
+  with Not_found ->
+    let found = ref None in
+    ignore (visitCilFunction (new varFinderClass vname found) fd);
+    !found
+
+let computeLiveTarget (fd : fundec) (vname : string) (vi : varinfo) : unit =
+  Cfg.clearCFGinfo fd;
+  ignore (Cfg.cfgFun fd);
+  live_target := vname;
+  (* Whatever a global holds on return can still be observed by the caller *)
+  live_at_exit := vi.vglob;
+  let stmts = ref [] in
+  ignore (visitCilBlock (new stmtCollectorClass stmts) fd.sbody);
+  IH.clear LiveTargetDF.stmtStartData;
+  List.iter (fun s -> IH.replace LiveTargetDF.stmtStartData s.sid false) !stmts;
+  LiveTarget.compute !stmts
+
+let live_in (s : stmt) : bool =
+  try IH.find LiveTargetDF.stmtStartData s.sid with Not_found -> true
+
+let live_out (s : stmt) : bool =
+  match s.succs with
+  | [] -> !live_at_exit
+  | succs -> List.exists live_in succs
+
+class seuWebPlacementVisitor (target_var : string) = object
+  inherit nopCilVisitor
+  val mutable sites = 0
+
+  method sites = sites
+
+  method vstmt (s : stmt) =
+    match s.skind with
+    | Instr il ->
+        let _, afters = List.fold_right (fun i (after, acc) ->
+            (instr_live_before target_var i after, after :: acc)) il (live_out s, []) in
+        let new_instrs = ref [] in
+        List.iter2 (fun i live_after ->
+          new_instrs := i :: !new_instrs;
+          match i with
+          | Set ((Var vi, NoOffset) as lv, _, loc)
+          | Call (Some ((Var vi, NoOffset) as lv), _, _, loc)
+            when vi.vname = target_var && live_after ->
+              sites <- sites + 1;
+              new_instrs := create_seu_call lv loc (sites - 1) :: !new_instrs
+          | _ -> ()
+        ) il afters;
+        s.skind <- Instr (List.rev !new_instrs);
+        SkipChildren
+    | _ -> DoChildren
+end
+
+(* Instrument fd in place for one variable, returning the number of injection sites, or None when
+   web placement cannot cover it: a struct field or other non-variable target, a variable whose
+   address is taken (writes through pointers are not definitions here), or no live definition *)
+let place_web_sites (fd : fundec) (vname : string) : int option =
+  match find_target_varinfo fd vname, fd.sbody.bstmts with
+  | Some vi, (first :: _ as stmts) when not vi.vaddrof ->
+      computeLiveTarget fd vname vi;
+      let entry_live = live_in first in
+      let vis = new seuWebPlacementVisitor vname in
+      ignore (visitCilFunction (vis :> cilVisitor) fd);
+      let sites =
+        if entry_live then begin
+          let call = create_seu_call (Var vi, NoOffset) (get_stmtLoc first.skind) vis#sites in
+          fd.sbody.bstmts <- mkStmtOneInstr call :: stmts;
+          vis#sites + 1
+        end else vis#sites
+      in
+      if sites > 0 then Some sites else None
+  | _ -> None
+
+let placement = ref "use"
+let report_sites = ref false
+
+(* Instrument fd in place for one variable with the selected placement, returning the site count *)
+let instrument_function (placement : string) (fd : fundec) (vname : string) : int =
+  site_locations := [];
+  let sites =
+    let per_use () =
+      let vis = new seuInstrumentationVisitor vname in
+      ignore (visitCilFunction (vis :> cilVisitor) fd);
+      vis#sites
+    in
+    if placement <> "web" then per_use ()
+    else match place_web_sites fd vname with
+      | Some sites -> sites
+      | None ->
+          (* place_web_sites only changes fd once it has found a site *)
+          E.warn "--placement web cannot place %s in %s, falling back to per-use placement"
+            vname fd.svar.vname;
+          per_use ()
+  in
+  if !select_site && sites > 0 then add_site_selection fd sites;
+  sites
+
+(* Build one <func>_prime_<var> copy of fd per candidate variable, leaving fd untouched *)
+let instrument_copies (fd : fundec) (loc : location) (vars : string list) : global list =
+  List.map (fun v ->
+    let copy = copyFunction fd (fd.svar.vname ^ "_prime_" ^ v) in
+    let sites = instrument_function !placement copy v in
+    if !report_sites then begin
+      if !select_site then
+        List.iter (fun (site, l) ->
+          Printf.eprintf "[sites] %s site %d: %s:%d\n" copy.svar.vname site l.file l.line
+        ) (List.rev !site_locations);
+      let use_sites =
+        if !placement = "use" then sites
+        else instrument_function "use" (copyFunction fd copy.svar.vname) v
+      in
+      Printf.eprintf "[sites] %s: %d per-use, %d with --placement %s\n"
+        copy.svar.vname use_sites sites !placement
+    end;
+    GFun (copy, loc)
+  ) vars
+
+(* Locate the definition of the entry function *)
+let find_entry (f : file) (entry : string) : fundec * location =
+  let rec find = function
+    | GFun (fd, loc) :: _ when fd.svar.vname = entry -> fd, loc
+    | _ :: rest -> find rest
+    | [] -> E.s (E.error "Function %s not found in %s" entry f.fileName)
+  in
+  find f.globals
+
+(* Insert the instrumented copies of the entry function right after its definition *)
+let with_prime_copies (f : file) (entry : string) (vars : string list) : file =
+  let entry_fd, loc = find_entry f entry in
+  let globals = List.concat (List.map (function
+    | GFun (fd, _) as g when fd == entry_fd -> g :: instrument_copies fd loc vars
+    | g -> [g]) f.globals) in
+  { f with globals = globals }
+
+(* Harness generation: a main that runs the original and the instrumented function on the same
+   nondeterministic inputs and asserts that the safety property holds for both or for neither.
+   With several variables the original runs once and every instrumented copy is asserted against
+   it, so a single CBMC run checks all candidates and encodes the original computation only once.
+   The harness checks a single call of the entry function (one step of the controller loop in the
+   original main), so the loop of main is never unrolled. With --state nondet that step starts from
+   any prior state rather than from the initializers; --steps k chains k calls from it, for
+   properties that need the history of a few steps. *)
+let harness = ref false
+let property = ref ""
+let prior_state = ref "initial"
+let state_assumes : string list ref = ref []
+let steps = ref 1
+let feedback = ref ""
+
+(* The safety property is the '//' comment on line 3 of every 30_problems controller *)
+let read_property (source : string) : string =
+  let ic = open_in_bin source in
+  let line =
+    try ignore (input_line ic); ignore (input_line ic); String.trim (input_line ic)
+    with End_of_file -> ""
+  in
+  close_in ic;
+  let len = String.length line in
+  if len > 2 && String.sub line 0 2 = "//" then String.trim (String.sub line 2 (len - 2))
+  else E.s (E.error "No safety property on line 3 of %s (use --property <expr>)" source)
+
+let c_keywords = ["sizeof"; "true"; "false"; "int"; "char"; "short"; "long"; "unsigned";
+                  "signed"; "float"; "double"; "_Bool"; "bool"]
+
+(* Identifiers of the property that are neither globals, enum constants nor (upper-case) macros:
+   the local output variable of the controller, bound to the return value in the harness *)
+let output_identifiers (f : file) (prop : string) : string list =
+  let known = Hashtbl.create 64 in
+  List.iter (function
+    | GVar (vi, _, _) | GVarDecl (vi, _) -> Hashtbl.replace known vi.vname ()
+    | GFun (fd, _) -> Hashtbl.replace known fd.svar.vname ()
+    | GEnumTag (ei, _) -> List.iter (fun (n, _, _) -> Hashtbl.replace known n ()) ei.eitems
+    | _ -> ()) f.globals;
+  let is_word c =
+    match c with 'A'..'Z' | 'a'..'z' | '0'..'9' | '_' -> true | _ -> false in
+  let re = Str.regexp "[A-Za-z_][A-Za-z0-9_]*" in
+  let rec collect pos acc =
+    match (try Some (Str.search_forward re prop pos) with Not_found -> None) with
+    | None -> List.rev acc
+    | Some p ->
+        let id = Str.matched_string prop in
+        (* Skip the tails of numbers (0x1F, 1e5) and field names *)
+        let field = p > 0 && (prop.[p - 1] = '.' || (p > 1 && String.sub prop (p - 2) 2 = "->")) in
+        let keep = not (p > 0 && is_word prop.[p - 1]) && not field
+                   && not (Hashtbl.mem known id) && not (List.mem id c_keywords)
+                   && String.uppercase id <> id && not (List.mem id acc) in
+        collect (p + String.length id) (if keep then id :: acc else acc)
+  in
+  collect 0 []
+
+(* Name and return type of the CBMC nondet_ function producing a value of type t *)
+let nondet_function (t : typ) : (string * string) option =
+  match unrollType t with
+  | TInt (IBool, _) -> Some ("nondet_bool", "_Bool")
+  | TInt (IChar, _) -> Some ("nondet_char", "char")
+  | TInt (ISChar, _) -> Some ("nondet_schar", "signed char")
+  | TInt (IUChar, _) -> Some ("nondet_uchar", "unsigned char")
+  | TInt (IShort, _) -> Some ("nondet_short", "short")
+  | TInt (IUShort, _) -> Some ("nondet_ushort", "unsigned short")
+  | TInt (IInt, _) | TEnum _ -> Some ("nondet_int", "int")
+  | TInt (IUInt, _) -> Some ("nondet_uint", "unsigned int")
+  | TInt (ILong, _) -> Some ("nondet_long", "long")
+  | TInt (IULong, _) -> Some ("nondet_ulong", "unsigned long")
+  | TInt (ILongLong, _) -> Some ("nondet_longlong", "long long")
+  | TInt (IULongLong, _) -> Some ("nondet_ulonglong", "unsigned long long")
+  | TFloat (FFloat, _) -> Some ("nondet_float", "float")
+  | TFloat (FDouble, _) -> Some ("nondet_double", "double")
+  | TFloat (FLongDouble, _) -> Some ("nondet_longdouble", "long double")
+  | _ -> None
+
+(* "t name" as a C declaration, without the qualifiers that would stop the harness from assigning it *)
+let c_decl (name : string) (t : typ) : string =
+  let t = typeRemoveAttributes ["volatile"; "const"] t in
+  sprint 200 (defaultCilPrinter#pType (Some (text name)) () t)
+
+let is_volatile (t : typ) : bool = hasAttribute "volatile" (typeAttrs t)
+let is_const (t : typ) : bool = hasAttribute "const" (typeAttrs t)
+
+(* The harness for the entry function fd and its instrumented copies for vars *)
+let make_harness (f : file) (fd : fundec) (vars : string list) (prop : string) : string =
+  let b = Buffer.create 1024 in
+  let line fmt = Printf.ksprintf (fun l -> Buffer.add_string b l; Buffer.add_char b '\n') fmt in
+  let prototypes = Hashtbl.create 8 in
+  let nondet (t : typ) : string =
+    match nondet_function t with
+    | Some (name, rt) ->
+        Hashtbl.replace prototypes name rt;
+        Printf.sprintf "(%s)%s()" (c_decl "" t) name
+    | None -> E.s (E.error "No nondet_ function for %a in the harness" d_type t)
+  in
+  let rt = match unrollType fd.svar.vtype with
+    | TFun (rt, _, _, _) -> rt
+    | _ -> voidType
+  in
+  let returns = not (isVoidType rt) in
+  (* The globals the controller may read or update, except const ones and CBMC/libc internals *)
+  let globals = List.fold_right (fun g acc ->
+      match g with
+      | GVar (vi, _, _) when not (is_const vi.vtype)
+                             && not (String.length vi.vname > 1 && String.sub vi.vname 0 2 = "__")
+                             && not (isFunctionType vi.vtype) -> vi :: acc
+      | _ -> acc) f.globals [] in
+  let output_id = match output_identifiers f prop with
+    | [] -> None
+    | [id] when returns -> Some id
+    | [id] -> E.s (E.error "%s in the property is not a global and %s returns void" id fd.svar.vname)
+    | ids -> E.s (E.error "Cannot tell which of %s in the property is the output" (String.concat ", " ids))
+  in
+  let k = !steps in
+  if k < 1 then E.s (E.error "--steps needs a positive number of steps");
+  if !feedback <> "" && not (returns && List.exists (fun vi -> vi.vname = !feedback) fd.sformals) then
+    E.s (E.error "--feedback %s is not a parameter of %s or %s returns void" !feedback fd.svar.vname fd.svar.vname);
+  let suffix i = if k = 1 then "" else Printf.sprintf "_%d" i in
+  let rec range i = if i > k then [] else i :: range (i + 1) in
+  let body = Buffer.create 1024 in
+  let add fmt = Printf.ksprintf (fun l -> Buffer.add_string body ("    " ^ l ^ "\n")) fmt in
+  (* -D CRV_REENTRANT makes every call of the harness start from the globals of its first call and
+     with no SEU injected, for in-process fuzzers that run it once per input (fuzz/crv_libfuzzer.c) *)
+  let reentrant = Buffer.create 256 in
+  List.iter (fun vi ->
+      Buffer.add_string reentrant (Printf.sprintf "    static %s;\n" (c_decl ("crv_initial_" ^ vi.vname) vi.vtype))) globals;
+  let copy_globals (to_initial : bool) =
+    List.iter (fun vi ->
+        let initial = "crv_initial_" ^ vi.vname in
+        let dst, src = if to_initial then initial, vi.vname else vi.vname, initial in
+        Buffer.add_string reentrant
+          (match unrollType vi.vtype with
+           | TArray _ -> Printf.sprintf "        __builtin_memcpy(%s, %s, sizeof(%s));\n" dst src initial
+           | _ -> Printf.sprintf "        %s = %s;\n" dst src)) globals
+  in
+  Buffer.add_string reentrant "    static int crv_started = 0;\n    if(!crv_started) {\n";
+  copy_globals true;
+  Buffer.add_string reentrant "        crv_started = 1;\n    } else {\n";
+  copy_globals false;
+  Buffer.add_string reentrant "    }\n    simulate_seu_reset();\n";
+  (* Nondet inputs of every step: every parameter and every volatile scalar global; the --feedback
+     parameter only gets one for the first step and then takes the previous return value *)
+  let inputs = List.filter (fun vi ->
+      is_volatile vi.vtype && isArithmeticOrPointerType vi.vtype && not (isPointerType vi.vtype)) globals in
+  List.iter (fun i ->
+      List.iter (fun vi ->
+          if i = 1 || vi.vname <> !feedback then
+            add "%s = %s;" (c_decl ("crv_in_" ^ vi.vname ^ suffix i) vi.vtype) (nondet vi.vtype)) fd.sformals;
+      List.iter (fun vi ->
+          if k = 1 then add "%s = %s;" vi.vname (nondet vi.vtype)
+          else add "%s = %s;" (c_decl ("crv_in_" ^ vi.vname ^ suffix i) vi.vtype) (nondet vi.vtype)) inputs)
+    (range 1);
+  (* Prior state: the other globals hold whatever an earlier step left in them. Scalars come from
+     nondet_ functions like the inputs, so a replay can feed them (see crv_replay.h); for structs and
+     arrays (queue contents) CBMC gives an uninitialized local an arbitrary value *)
+  if !prior_state = "nondet" then begin
+    List.iter (fun vi ->
+        if not (List.memq vi inputs) then
+          match unrollType vi.vtype, nondet_function vi.vtype with
+          | TArray _, _ ->
+              add "{ %s; __builtin_memcpy(%s, crv_any_%s, sizeof(crv_any_%s)); }"
+                (c_decl ("crv_any_" ^ vi.vname) vi.vtype) vi.vname vi.vname vi.vname
+          | _, Some _ -> add "%s = %s;" vi.vname (nondet vi.vtype)
+          | _, None -> add "{ %s; %s = crv_any_%s; }" (c_decl ("crv_any_" ^ vi.vname) vi.vtype) vi.vname vi.vname) globals;
+    List.iter (fun a -> add "__CPROVER_assume(%s);" a) (List.rev !state_assumes)
+  end;
+  (* Both runs start from the same global state *)
+  List.iter (fun vi ->
+      let saved = "crv_saved_" ^ vi.vname in
+      match unrollType vi.vtype with
+      | TArray _ ->
+          add "%s;" (c_decl saved vi.vtype);
+          add "__builtin_memcpy(%s, %s, sizeof(%s));" saved vi.vname saved
+      | _ -> add "%s = %s;" (c_decl saved vi.vtype) vi.vname) globals;
+  let restore () =
+    List.iter (fun vi ->
+        let saved = "crv_saved_" ^ vi.vname in
+        match unrollType vi.vtype with
+        | TArray _ -> add "__builtin_memcpy(%s, %s, sizeof(%s));" vi.vname saved saved
+        | _ -> add "%s = %s;" vi.vname saved) globals
+  in
+  (* Step i of a run: out_i and phi_i, the property after it *)
+  let call (fname : string) (out : string) (phi : string) (i : int) =
+    if k > 1 then List.iter (fun vi -> add "%s = crv_in_%s%s;" vi.vname vi.vname (suffix i)) inputs;
+    let args = List.map (fun vi ->
+        if i > 1 && vi.vname = !feedback then out ^ suffix (i - 1)
+        else "crv_in_" ^ vi.vname ^ suffix i) fd.sformals in
+    let call = Printf.sprintf "%s(%s)" fname (String.concat ", " args) in
+    let out, phi = out ^ suffix i, phi ^ suffix i in
+    if returns then add "%s = %s;" (c_decl out rt) call else add "%s;" call;
+    match output_id with
+    | Some id -> add "int %s; { %s = %s; %s = (%s); }" phi (c_decl id rt) out phi prop
+    | None -> add "int %s = (%s);" phi prop
+  in
+  let run (fname : string) (out : string) (phi : string) = List.iter (call fname out phi) (range 1) in
+  run fd.svar.vname "crv_out" "phi";
+  (* Every copy starts from the inputs and globals of the original run, with no SEU injected yet;
+     over several steps the SEU hits at most one of them and the verdicts may differ after any *)
+  List.iter (fun var ->
+      restore ();
+      if List.length vars > 1 then add "simulate_seu_reset();";
+      run (fd.svar.vname ^ "_prime_" ^ var) ("crv_out_prime_" ^ var) ("phi_prime_" ^ var);
+      let differs = List.map (fun i ->
+          Printf.sprintf "(phi%s ^ phi_prime_%s%s)" (suffix i) var (suffix i)) (range 1) in
+      add "__CPROVER_assert(!(%s), \"%s is a CRV\");" (String.concat " || " differs) var) vars;
+  add "return 0;";
+  line "\n// ----- CRV Harness -----\n";
+  line "// Property: %s" prop;
+  line "#undef main";
+  (* -D CRV_HARNESS=<name> renames the harness, so that a native driver can run it repeatedly (crv_fuzz.c) *)
+  line "#ifndef CRV_HARNESS";
+  line "#define CRV_HARNESS main";
+  line "#endif";
+  Hashtbl.iter (fun name rt -> line "%s %s(void);" rt name) prototypes;
+  line "";
+  line "int CRV_HARNESS(void) {";
+  line "#ifdef CRV_REENTRANT";
+  Buffer.add_buffer b reentrant;
+  line "#endif";
+  Buffer.add_buffer b body;
+  line "}";
+  Buffer.contents b
+
+(* Copy the original source verbatim (without CRs) and append the renamed instrumented copies,
+   giving the file CBMC is run on without going through gcc -E and sed. A harness also needs
+   simulate_seu.h and renames the original main out of its way. *)
+let write_combined (source : string) (output_file : string) (primes : global list)
+    (harness_code : string option) : unit =
+  let ic = open_in_bin source in
+  let oc = open_out output_file in
+  if harness_code <> None then
+    output_string oc "#include \"simulate_seu.h\"\n#define main crv_original_main\n";
+  (try
+     while true do
+       let line = input_line ic in
+       let len = String.length line in
+       if len > 0 && line.[len - 1] = '\r' then output oc line 0 (len - 1)
+       else output_string oc line;
+       output_char oc '\n'
+     done
+   with End_of_file -> ());
+  close_in ic;
+  output_string oc "\n\n// ----- Renamed Instrumented Function -----\n\n";
+  let old_style, old_input = !lineDirectiveStyle, !print_CIL_Input in
+  lineDirectiveStyle := None;
+  print_CIL_Input := false;
+  List.iter (dumpGlobal defaultCilPrinter oc) primes;
+  lineDirectiveStyle := old_style;
+  print_CIL_Input := old_input;
+  (match harness_code with
+   | Some code -> output_string oc code
+   | None -> ());
+  close_out oc
+
+(* Stage timers (--profile <file>): every stage runs under Stats.time, which prints the usual CIL
+   timing tree on stderr, and its CPU time is also summed per call path so that the file gets one
+   collapsed-stack line "instrument_seu;<stage>;<substage> <microseconds>" of self time per path,
+   the input format of flamegraph tools. *)
+let profile_file = ref ""
+let profile_stack : string list ref = ref []
+let profile_times : (string, float) Hashtbl.t = Hashtbl.create 16
+
+let timed (name : string) (f : 'a -> 'b) (x : 'a) : 'b =
+  let path = String.concat ";" (List.rev (name :: !profile_stack)) in
+  profile_stack := name :: !profile_stack;
+  let start = Sys.time () in
+  let finish () =
+    profile_stack := List.tl !profile_stack;
+    let total = try Hashtbl.find profile_times path with Not_found -> 0.0 in
+    Hashtbl.replace profile_times path (total +. Sys.time () -. start)
+  in
+  try
+    let result = Stats.time name f x in
+    finish ();
+    result
+  with e -> finish (); raise e
+
+(* Self time of a path: its total minus the totals of its direct children *)
+let write_profile () =
+  if !profile_file <> "" then begin
+    let depth path = List.length (Str.split (Str.regexp ";") path) in
+    let is_child parent path =
+      depth path = depth parent + 1
+      && String.length path > String.length parent
+      && String.sub path 0 (String.length parent + 1) = parent ^ ";" in
+    let oc = open_out !profile_file in
+    Hashtbl.iter (fun path total ->
+        let children = Hashtbl.fold (fun p t acc -> if is_child path p then acc +. t else acc) profile_times 0.0 in
+        Printf.fprintf oc "instrument_seu;%s %d\n" path
+          (max 0 (int_of_float ((total -. children) *. 1e6))))
+      profile_times;
+    close_out oc;
+    Stats.print stderr "instrument_seu stage times:\n"
+  end
+
+(* Instrument target_vars in an already parsed file and write output_file.
+   Only the legacy mode (no entry function) modifies f itself. *)
+let instrument_file (f : file) (entry : string) (combine : string)
+    (output_file : string) (target_vars : string list) : unit =
+  if combine <> "" then begin
+    if entry = "" then E.s (E.error "--combine needs --entry <function>");
+    let fd, loc = find_entry f entry in
+    let primes = timed "visit" (instrument_copies fd loc) target_vars in
+    let harness_code =
+      if not !harness then None
+      else
+        let prop = if !property <> "" then !property else read_property combine in
+        Some (timed "harness" (make_harness f fd target_vars) prop)
+    in
+    timed "dump" (write_combined combine output_file primes) harness_code
+  end else begin
+    if !harness then E.s (E.error "--harness needs --entry <function> and --combine <source>");
+    let f =
+      if entry <> "" then timed "visit" (with_prime_copies f entry) target_vars
+      else begin
+        (* Legacy mode: instrument every function in place for a single variable *)
+        let target_var = match target_vars with
+          | [v] -> v
+          | _ -> E.s (E.error "Several variables need --entry <function>")
+        in
+        timed "visit" (iterGlobals f) (function
+          | GFun (fd, _) -> ignore (instrument_function !placement fd target_var)
+          | _ -> ());
+        f
+      end
+    in
+    let out_channel = open_out output_file in
+    timed "dump" (dumpFile defaultCilPrinter out_channel output_file) f;
+    close_out out_channel
+  end
+
+(* Candidate enumeration (--list-vars): the parameters, volatile globals and locals of a function,
+   printed as "<kind> <name>" lines. Run on the full and on the sliced program, the difference is
+   the set of variables that cannot influence the output and are therefore not CRVs. *)
+let list_vars = ref ""
+
+class usedVarsClass (used : (int, varinfo) Hashtbl.t) = object
+  inherit nopCilVisitor
+  method vvrbl (vi : varinfo) = Hashtbl.replace used vi.vid vi; SkipChildren
+end
+
+(* Temporaries introduced by CIL or Frama-C rather than by the programmer *)
+let is_temporary (vi : varinfo) : bool =
+  (String.length vi.vname > 1 && String.sub vi.vname 0 2 = "__")
+  || Str.string_match (Str.regexp "^tmp\\(_[0-9]+\\|___[0-9]+\\)?$") vi.vname 0
+
+(* With only_used, parameters the function never reads (e.g. after slicing) are left out too *)
+let candidate_variables (f : file) (entry : string) (only_used : bool) : (string * string) list =
+  let fd, _ = find_entry f entry in
+  let used = Hashtbl.create 32 in
+  ignore (visitCilFunction (new usedVarsClass used) fd);
+  let keep vi = not (is_temporary vi) && Hashtbl.mem used vi.vid in
+  let params = List.filter (fun vi -> not (is_temporary vi) && (not only_used || keep vi)) fd.sformals in
+  let locals = List.filter keep fd.slocals in
+  let globals = Hashtbl.fold (fun _ vi acc ->
+      if vi.vglob && not (isFunctionType vi.vtype) && not (is_temporary vi)
+         && hasAttribute "volatile" (typeAttrs vi.vtype)
+      then vi :: acc else acc) used [] in
+  let globals = List.sort (fun a b -> compare a.vname b.vname) globals in
+  List.map (fun vi -> "param", vi.vname) params
+  @ List.map (fun vi -> "global", vi.vname) globals
+  @ List.map (fun vi -> "local", vi.vname) locals
+
+(* Slice fingerprint (--fingerprint): a digest of every function and of the other globals as CIL
+   prints them, without locations, so that comments, formatting and code outside the slice do not
+   change it. Two sliced files with the same fingerprint give the same instrumented copies and verdicts. *)
+let fingerprint = ref false
+
+let slice_fingerprint (f : file) : (string * string) list =
+  let old_style = !lineDirectiveStyle in
+  lineDirectiveStyle := None;
+  let functions, others = List.fold_left (fun (fs, os) g ->
+      let text = sprint 1000 (d_global () g) in
+      match g with
+      | GFun (fd, _) -> (fd.svar.vname, Digest.to_hex (Digest.string text)) :: fs, os
+      | _ -> fs, text :: os) ([], []) f.globals in
+  lineDirectiveStyle := old_style;
+  let entries =
+    List.rev functions @ ["<globals>", Digest.to_hex (Digest.string (String.concat "\n" (List.rev others)))] in
+  entries @ ["<slice>", Digest.to_hex (Digest.string (String.concat " " (List.map snd entries)))]
+
+(* Server mode: one JSON object per line on stdin, e.g.
+   {"input": "cs1_sliced.c", "entry": "p", "variables": ["x", "y"], "output": "cs1_cbmc_ready.c", "combine": "cs1_org.c"}
+   and one JSON status line per request on stdout. Parsed files stay cached by content digest. *)
+type json_value = JString of string | JList of string list
+
+exception Bad_request of string
+
+(* Just enough JSON for flat objects whose values are strings or lists of strings *)
+let parse_request (line : string) : (string * json_value) list =
+  let len = String.length line in
+  let pos = ref 0 in
+  let peek () =
+    if !pos < len then line.[!pos] else raise (Bad_request "unexpected end of request") in
+  let rec skip_ws () =
+    if !pos < len && String.contains " \t\r\n" line.[!pos] then (incr pos; skip_ws ()) in
+  let expect c =
+    skip_ws ();
+    if peek () <> c then raise (Bad_request (Printf.sprintf "expected '%c' at column %d" c !pos));
+    incr pos in
+  let parse_string () =
+    expect '"';
+    let b = Buffer.create 32 in
+    let rec loop () =
+      match peek () with
+      | '"' -> incr pos
+      | '\\' ->
+          incr pos;
+          (match peek () with
+           | 'n' -> Buffer.add_char b '\n'
+           | 't' -> Buffer.add_char b '\t'
+           | 'r' -> Buffer.add_char b '\r'
+           | 'b' -> Buffer.add_char b '\b'
+           | 'f' -> Buffer.add_char b '\012'
+           | 'u' when !pos + 4 < len ->
+               let code = int_of_string ("0x" ^ String.sub line (!pos + 1) 4) in
+               if code > 127 then raise (Bad_request "non-ASCII \\u escape");
+               Buffer.add_char b (Char.chr code);
+               pos := !pos + 4
+           | c -> Buffer.add_char b c);
+          incr pos;
+          loop ()
+      | c -> Buffer.add_char b c; incr pos; loop ()
+    in
+    loop ();
+    Buffer.contents b
+  in
+  let parse_value () =
+    skip_ws ();
+    match peek () with
+    | '"' -> JString (parse_string ())
+    | '[' ->
+        incr pos;
+        skip_ws ();
+        if peek () = ']' then (incr pos; JList []) else begin
+          let rec items acc =
+            let acc = parse_string () :: acc in
+            skip_ws ();
+            match peek () with
+            | ',' -> incr pos; items acc
+            | ']' -> incr pos; JList (List.rev acc)
+            | _ -> raise (Bad_request "expected ',' or ']'")
+          in
+          items []
+        end
+    | _ -> raise (Bad_request "values must be strings or lists of strings")
+  in
+  expect '{';
+  skip_ws ();
+  if peek () = '}' then [] else begin
+    let rec fields acc =
+      let key = parse_string () in
+      expect ':';
+      let acc = (key, parse_value ()) :: acc in
+      skip_ws ();
+      match peek () with
+      | ',' -> incr pos; fields acc
+      | '}' -> List.rev acc
+      | _ -> raise (Bad_request "expected ',' or '}'")
+    in
+    fields []
+  end
+
+let json_escape (str : string) : string =
+  let b = Buffer.create (String.length str + 2) in
+  String.iter (function
+    | '"' -> Buffer.add_string b "\\\""
+    | '\\' -> Buffer.add_string b "\\\\"
+    | '\n' -> Buffer.add_string b "\\n"
+    | c when Char.code c < 32 -> Buffer.add_string b (Printf.sprintf "\\u%04x" (Char.code c))
+    | c -> Buffer.add_char b c) str;
+  Buffer.contents b
+
+let parse_cache : (Digest.t, file) Hashtbl.t = Hashtbl.create 16
+
+(* Parse input_file unless a file with the same contents was parsed before *)
+let parse_cached (input_file : string) : file * bool =
+  let key = Digest.file input_file in
+  try Hashtbl.find parse_cache key, true
+  with Not_found ->
+    let f = timed "parse" (Frontc.parse input_file) () in
+    Hashtbl.add parse_cache key f;
+    f, false
+
+let serve_request (line : string) : string =
+  let fields = parse_request line in
+  let field name =
+    match (try Some (List.assoc name fields) with Not_found -> None) with
+    | Some (JString v) -> v
+    | Some (JList _) -> raise (Bad_request (name ^ " must be a string"))
+    | None -> ""
+  in
+  let required name =
+    let v = field name in
+    if v = "" then raise (Bad_request ("missing " ^ name)) else v
+  in
+  let vars =
+    match (try List.assoc "variables" fields with Not_found -> JList []) with
+    | JString v -> [v]
+    | JList [] -> raise (Bad_request "missing variables")
+    | JList vs -> vs
+  in
+  let input_file = required "input" in
+  let output_file = required "output" in
+  (* The legacy in-place mode would corrupt the cached file *)
+  let entry = required "entry" in
+  let f, cached = parse_cached input_file in
+  instrument_file f entry (field "combine") output_file vars;
+  Printf.sprintf "{\"status\": \"ok\", \"output\": \"%s\", \"cached\": %b}"
+    (json_escape output_file) cached
+
+let error_reply (msg : string) : string =
+  Printf.sprintf "{\"status\": \"error\", \"message\": \"%s\"}" (json_escape msg)
+
+let serve () =
+  try
+    while true do
+      let line = input_line stdin in
+      if String.length line > 0 then begin
+        let reply =
+          try serve_request line with
+          | Bad_request msg | Frontc.ParseError msg | Failure msg | Sys_error msg ->
+              error_reply msg
+          | E.Error ->
+              E.hadErrors := false;
+              error_reply "instrumentation failed, see stderr"
+        in
+        print_endline reply;
+        flush stdout
+      end
+    done
+  with End_of_file -> ()
+
+let entry_func = ref ""
+let combine_source = ref ""
+let server = ref false
+let anon_args = ref []
+
+let usage =
+  "Usage: instrument_seu [options] <input_file> <output_file> <variable> [<variable> ...]"
+
+let options = [
+  "--entry", Arg.Set_string entry_func,
+  "<function> Emit one <function>_prime_<variable> copy per variable from a single parse";
+  "--combine", Arg.Set_string combine_source,
+  "<source> Write <source> followed by the renamed instrumented copies (needs --entry)";
+  "--placement", Arg.Symbol (["use"; "web"], (fun p -> placement := p)),
+  " Inject before every use (default) or once after each live definition (dataflow)";
+  "--sites", Arg.Set report_sites,
+  " Report the number of injection sites per instrumented copy, before and after placement";
+  "--select-site", Arg.Set select_site,
+  " Number the injection sites and flip only the one chosen nondeterministically on entry";
+  "--harness", Arg.Set harness,
+  " Append a CBMC main asserting the safety property for the original and every instrumented copy, one assertion per variable (needs --combine)";
+  "--property", Arg.Set_string property,
+  "<expr> Safety property for --harness instead of the comment on line 3 of the --combine source";
+  "--state", Arg.Symbol (["initial"; "nondet"], (fun m -> prior_state := m)),
+  " Start the --harness step from the initializers of the globals (default) or from any prior state of them";
+  "--state-assume", Arg.String (fun a -> state_assumes := a :: !state_assumes),
+  "<expr> Invariant of the nondet prior state, e.g. a queue count within bounds (repeatable)";
+  "--steps", Arg.Set_int steps,
+  "<k> Chain k calls of the entry function in the --harness, each with fresh inputs (default 1)";
+  "--feedback", Arg.Set_string feedback,
+  "<parameter> Pass the return value of each --steps call to <parameter> of the next, like the main loop does";
+  "--list-vars", Arg.Symbol (["used"; "all"], (fun m -> list_vars := m)),
+  " Print the parameters, volatile globals and locals used by the --entry function of <input_file> and exit (all: with unread parameters)";
+  "--fingerprint", Arg.Set fingerprint,
+  " Print a digest per function, one for the other globals and one for the whole (sliced) <input_file> and exit";
+  "--profile", Arg.Set_string profile_file,
+  "<file> Time the parse, visit, harness and dump stages (CIL timing tree on stderr) and write their collapsed stacks to <file>";
+  "--server", Arg.Set server,
+  " Answer JSON-line requests on stdin, keeping parsed files cached";
+]
+
+let main () =
+  Arg.parse options (fun a -> anon_args := a :: !anon_args) usage;
+  if !profile_file <> "" then begin
+    Stats.reset Stats.SoftwareTimer;
+    at_exit write_profile
+  end;
+  if !server then (serve (); exit 0);
+  if !fingerprint then begin
+    match List.rev !anon_args with
+    | [input_file] ->
+        let f = timed "parse" (Frontc.parse input_file) () in
+        List.iter (fun (name, digest) -> Printf.printf "%s %s\n" name digest) (timed "fingerprint" slice_fingerprint f);
+        exit 0
+    | _ -> E.s (E.error "--fingerprint needs a single <input_file>")
+  end;
+  if !list_vars <> "" then begin
+    match List.rev !anon_args with
+    | [input_file] when !entry_func <> "" ->
+        let f = timed "parse" (Frontc.parse input_file) () in
+        List.iter (fun (kind, name) -> Printf.printf "%s %s\n" kind name)
+          (timed "list-vars" (candidate_variables f !entry_func) (!list_vars = "used"));
+        exit 0
+    | _ -> E.s (E.error "--list-vars needs --entry <function> and a single <input_file>")
+  end;
+  let input_file, output_file, target_vars =
+    match List.rev !anon_args with
+    | i :: o :: (_ :: _ as vars) -> i, o, vars
+    | _ -> Arg.usage options usage; exit 1
+  in
+  let f = timed "parse" (Frontc.parse input_file) () in
+  instrument_file f !entry_func !combine_source output_file target_vars
+
 let () =
-  if Array.length Sys.argv <> 4 then (
-    Printf.eprintf "Usage: %s <input_file> <output_file> <variable>\n" Sys.argv.(0);
-    exit 1
-  );
-  let input_file = Sys.argv.(1) in
-  let output_file = Sys.argv.(2) in
-  let target_var = Sys.argv.(3) in
-  let f = Frontc.parse input_file () in
-  iterGlobals f (function
-    | GFun (fd, _) -> ignore (visitCilFunction (new seuInstrumentationVisitor target_var) fd)
-    | _ -> ());
-  let out_channel = open_out output_file in
-  dumpFile defaultCilPrinter out_channel output_file f;
-  close_out out_channel
+  try main ()
+  with E.Error -> exit 1
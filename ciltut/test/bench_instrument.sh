@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Benchmarks instrument_seu on synthetic straight-line functions (Simulink-style code)
+# Usage: ./bench_instrument.sh [sizes...]   (default: 1000 10000 100000 instructions)
+
+# Path to the instrument_seu executable in the src directory
+INSTRUMENT_EXEC="${INSTRUMENT_EXEC:-../src/instrument_seu}"
+
+sizes=("$@")
+if [ ${#sizes[@]} -eq 0 ]; then
+    sizes=(1000 10000 100000)
+fi
+
+bench_dir=$(mktemp -d)
+trap 'rm -rf "$bench_dir"' EXIT
+
+printf "%-12s %-12s %-12s\n" "instructions" "wall_s" "peak_rss_kb"
+
+for n in "${sizes[@]}"
+do
+    input_file="$bench_dir/bench_${n}.c"
+    output_file="$bench_dir/bench_${n}_output.c"
+
+    # Every assignment reads x, so each one becomes an injection site
+    {
+        echo "int bench(int x) {"
+        echo "  int acc = 0;"
+        for ((i = 0; i < n; i++)); do
+            echo "  acc = acc + x;"
+        done
+        echo "  return acc;"
+        echo "}"
+    } > "$input_file"
+
+    /usr/bin/time -f "%e %M" -o "$bench_dir/time_${n}" \
+        $INSTRUMENT_EXEC "$input_file" "$output_file" x > /dev/null
+    read -r wall rss < "$bench_dir/time_${n}"
+
+    printf "%-12s %-12s %-12s\n" "$n" "$wall" "$rss"
+done
@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# Compares per-request latency of the one-shot instrument_seu binary against --server mode
+# Usage: ./bench_server.sh <sliced_file> <entry_function> <variable> [requests]
+# e.g.   ./bench_server.sh caseStudies/cs1/cs1_sliced.c p x 200
+
+# Path to the instrument_seu executable in the src directory
+INSTRUMENT_EXEC="${INSTRUMENT_EXEC:-../src/instrument_seu}"
+
+if [ $# -lt 3 ]; then
+    echo "Usage: $0 <sliced_file> <entry_function> <variable> [requests]"
+    exit 1
+fi
+
+input_file="$1"
+entry_function="$2"
+variable="$3"
+requests="${4:-100}"
+
+bench_dir=$(mktemp -d)
+trap 'rm -rf "$bench_dir"' EXIT
+
+now_ns() {
+    date +%s%N
+}
+
+# One process (startup + Frontc.parse) per request
+start=$(now_ns)
+for ((i = 0; i < requests; i++)); do
+    $INSTRUMENT_EXEC --entry "$entry_function" "$input_file" "$bench_dir/oneshot_$i.c" "$variable" > /dev/null
+done
+oneshot_ns=$(( $(now_ns) - start ))
+
+# Same requests answered by a single server process
+for ((i = 0; i < requests; i++)); do
+    printf '{"input": "%s", "entry": "%s", "variables": ["%s"], "output": "%s"}\n' \
+        "$input_file" "$entry_function" "$variable" "$bench_dir/server_$i.c"
+done > "$bench_dir/requests.jsonl"
+
+start=$(now_ns)
+$INSTRUMENT_EXEC --server < "$bench_dir/requests.jsonl" > "$bench_dir/replies.jsonl"
+server_ns=$(( $(now_ns) - start ))
+
+failed=$(grep -vc '"status": "ok"' "$bench_dir/replies.jsonl")
+if [ "$failed" -ne 0 ]; then
+    echo "[!] $failed server requests failed:"
+    grep -v '"status": "ok"' "$bench_dir/replies.jsonl" | head -5
+fi
+
+if ! cmp -s "$bench_dir/oneshot_0.c" "$bench_dir/server_0.c"; then
+    echo "[!] server output differs from the one-shot output"
+fi
+
+echo "requests:              $requests"
+echo "one-shot ms/request:   $(awk -v t="$oneshot_ns" -v n="$requests" 'BEGIN { printf "%.3f", t / n / 1e6 }')"
+echo "server ms/request:     $(awk -v t="$server_ns" -v n="$requests" 'BEGIN { printf "%.3f", t / n / 1e6 }')"
@@ -0,0 +1,404 @@
+(* Frama-C port of ciltut/src/instrument_seu.ml: instruments the entry function of the sliced
+   project right after 'Slicing export', without printing and re-parsing a _sliced.c file
+
+   frama-c controller.c -main step -slice-value new_rate -slicing-level 3 \
+     -then-on 'Slicing export' -seu-entry step -seu-var drug_profile_id,pump_enabled \
+     -seu-combine controller.c -seu-output controller_cbmc_ready.c *)
+
+open Cil_types
+
+module Self = Plugin.Register (struct
+  let name = "SEU instrumentation"
+  let shortname = "seu"
+  let help = "inserts simulate_seu_main calls into <f>_prime_<variable> copies of a function"
+end)
+
+module Entry = Self.String (struct
+  let option_name = "-seu-entry"
+  let default = ""
+  let arg_name = "f"
+  let help = "function whose instrumented copies <f>_prime_<variable> are emitted"
+end)
+
+module Variables = Self.String_list (struct
+  let option_name = "-seu-var"
+  let arg_name = "v1,...,vn"
+  let help = "candidate variables, one instrumented copy of the entry function each"
+end)
+
+module Combine = Self.String (struct
+  let option_name = "-seu-combine"
+  let default = ""
+  let arg_name = "source"
+  let help = "write <source> followed by the instrumented copies (as instrument_seu --combine)"
+end)
+
+module Output = Self.String (struct
+  let option_name = "-seu-output"
+  let default = ""
+  let arg_name = "file"
+  let help = "file the instrumented copies are written to; a %v in the name writes one file per variable"
+end)
+
+module Select_site = Self.False (struct
+  let option_name = "-seu-select-site"
+  let help = "number the injection sites and flip only the one chosen nondeterministically on entry"
+end)
+
+module Unwindset = Self.String (struct
+  let option_name = "-seu-unwindset"
+  let default = ""
+  let arg_name = "file"
+  let help = "run EVA and write a CBMC --unwindset argument bounding every loop whose counter EVA bounds"
+end)
+
+module Unwind_max = Self.Int (struct
+  let option_name = "-seu-unwind-max"
+  let default = 0
+  let arg_name = "n"
+  let help = "leave loops whose EVA bound exceeds n (the global CBMC --unwind) out of -seu-unwindset; 0 keeps every bound"
+end)
+
+(* Function to check if an expression contains a specific variable *)
+let rec uses_variable (vname : string) (e : exp) : bool =
+  match e.enode with
+  | Lval (Var vi, NoOffset) -> vi.vname = vname
+  | Lval (_, offset) ->
+      (match offset with
+       | Field (fi, _) when fi.fname = vname -> true
+       | Index (idx, _) -> uses_variable vname idx
+       | _ -> false)
+  | BinOp (_, e1, e2, _) -> uses_variable vname e1 || uses_variable vname e2
+  | UnOp (_, e, _) -> uses_variable vname e
+  | AddrOf (Var vi, _) -> vi.vname = vname
+  | CastE (_, e) -> uses_variable vname e
+  | _ -> false
+
+(* Extract the first lval of the variable from an expression where it is used *)
+let rec extract_matching_lval (vname : string) (e : exp) : lval option =
+  match e.enode with
+  | Lval ((Var vi, NoOffset) as lv) when vi.vname = vname -> Some lv
+  | Lval ((_, Field (fi, _)) as lv) when fi.fname = vname -> Some lv
+  | Lval (_, Index (idx, _)) -> extract_matching_lval vname idx
+  | BinOp (_, e1, e2, _) ->
+      (match extract_matching_lval vname e1 with
+       | Some lv -> Some lv
+       | None -> extract_matching_lval vname e2)
+  | UnOp (_, e1, _) -> extract_matching_lval vname e1
+  | CastE (_, e1) -> extract_matching_lval vname e1
+  | _ -> None
+
+(* Pick the simulate_seu_main variant (see simulate_seu.h) modelling the real width of a type *)
+let seu_variant (t : typ) : string * typ =
+  let int_variant () =
+    match Cil.bitsSizeOf t with
+    | 8 -> "_u8", TInt (IUChar, [])
+    | 16 -> "_i16", TInt (IShort, [])
+    | 64 -> "_i64", TInt (ILongLong, [])
+    | _ -> "_i32", Cil.intType
+  in
+  match Cil.unrollType t with
+  | TInt (IBool, _) -> "_bool", TInt (IBool, [])
+  | TInt _ | TEnum _ | TPtr _ -> int_variant ()
+  | TFloat (FFloat, _) -> "_f32", TFloat (FFloat, [])
+  | TFloat (FDouble, _) -> "_f64", TFloat (FDouble, [])
+  | _ ->
+      Self.warning "No width-specific SEU model for %a, treating it as int" Printer.pp_typ t;
+      "_i32", Cil.intType
+
+(* The simulate_seu.h functions are only referenced by name in the printed code *)
+let seu_functions : (string, varinfo) Hashtbl.t = Hashtbl.create 17
+
+let seu_function (name : string) (params : (string * typ * attributes) list) : varinfo =
+  try Hashtbl.find seu_functions name
+  with Not_found ->
+    let vi = Cil.makeGlobalVar name (TFun (Cil.voidType, Some params, false, [])) in
+    Hashtbl.add seu_functions name vi;
+    vi
+
+(* Create the call simulate_seu_main(&x), its width variant, or simulate_seu_site(id, &x) *)
+let create_seu_call (lv : lval) (loc : location) (site : int) : stmt =
+  let t = Cil.typeOfLval lv in
+  let suffix, param_t = seu_variant t in
+  let addr = Cil.mkAddrOf ~loc lv in
+  let arg =
+    if Cil.typeSig t = Cil.typeSig param_t then addr
+    else Cil.new_exp ~loc (CastE (TPtr (param_t, []), addr))
+  in
+  let call =
+    if Select_site.get () then begin
+      let f = seu_function ("simulate_seu_site" ^ suffix)
+          ["site", Cil.intType, []; "arg", TPtr (param_t, []), []] in
+      Call (None, Cil.evar ~loc f, [Cil.integer ~loc site; arg], loc)
+    end else begin
+      let f = seu_function ("simulate_seu_main" ^ suffix) ["arg", TPtr (param_t, []), []] in
+      Call (None, Cil.evar ~loc f, [arg], loc)
+    end
+  in
+  Cil.mkStmtOneInstr ~valid_sid:true call
+
+let is_constant (e : exp) : bool =
+  match e.enode with
+  | Const _ -> true
+  | _ -> false
+
+(* Frama-C keeps one instruction per statement, so injections become statements placed
+   in a block in front of the statement that uses the variable *)
+class seuInstrumentationVisitor (target_var : string) = object(self)
+  inherit Cil.nopCilVisitor
+  val mutable initialized = false
+  val mutable sites = 0
+
+  method sites = sites
+
+  method private seu_call (lv : lval) (loc : location) : stmt =
+    sites <- sites + 1;
+    create_seu_call lv loc (sites - 1)
+
+  (* The variable as it appears in e, so that its declared type picks the SEU model *)
+  method private target_lval (e : exp) : lval =
+    match extract_matching_lval target_var e with
+    | Some lv -> lv
+    | None -> Var (Cil.makeGlobalVar target_var Cil.intType), NoOffset
+
+  method private use_in (e : exp) (loc : location) : stmt list =
+    if uses_variable target_var e then
+      match extract_matching_lval target_var e with
+      | Some lv -> [self#seu_call lv loc]
+      | None -> []
+    else []
+
+  method private injections (i : instr) : stmt list =
+    match i with
+    | Set ((Var vi, _) as lv, rhs, loc) when vi.vname = target_var ->
+        if not initialized && is_constant rhs then begin
+          initialized <- true; (* Skip first init assignment *)
+          []
+        end else [self#seu_call lv loc]
+    | Set (_, rhs, loc) -> self#use_in rhs loc
+    (* The declaration of the target itself cannot be preceded by &x, and flipping
+       the value it is about to overwrite has no effect anyway *)
+    | Local_init (vi, AssignInit (SingleInit rhs), _) when vi.vname = target_var ->
+        if is_constant rhs then initialized <- true;
+        []
+    | Local_init (_, AssignInit (SingleInit rhs), loc) -> self#use_in rhs loc
+    | Call (_, _, args, loc) | Local_init (_, ConsInit (_, args, _), loc) ->
+        (try self#use_in (List.find (uses_variable target_var) args) loc
+         with Not_found -> [])
+    | _ -> []
+
+  method! vstmt (s : stmt) =
+    let before calls =
+      Cil.ChangeTo (Cil.mkStmt ~valid_sid:true (Block (Cil.mkBlock (calls @ [s]))))
+    in
+    match s.skind with
+    | Instr i ->
+        (match self#injections i with
+         | [] -> Cil.SkipChildren
+         | calls -> before calls)
+
+    | If (cond, _, _, loc) when uses_variable target_var cond ->
+        let call = self#seu_call (self#target_lval cond) loc in
+        Cil.ChangeDoChildrenPost (s, fun s' ->
+          Cil.mkStmt ~valid_sid:true (Block (Cil.mkBlock [call; s'])))
+
+    | Switch (e, _, _, loc) when uses_variable target_var e ->
+        let call = self#seu_call (self#target_lval e) loc in
+        Cil.ChangeDoChildrenPost (s, fun s' ->
+          Cil.mkStmt ~valid_sid:true (Block (Cil.mkBlock [call; s'])))
+
+    | Return (Some e, loc) when uses_variable target_var e ->
+        (match self#use_in e loc with
+         | [] -> Cil.DoChildren
+         | calls -> before calls)
+
+    | _ -> Cil.DoChildren
+end
+
+(* Deep copy of fd named <f>_prime_<var>, instrumented for var *)
+let instrument_copy (fd : fundec) (var : string) : fundec =
+  let copier = new Cil.genericCilVisitor (Visitor_behavior.copy (Project.current ())) in
+  let copy = Cil.visitCilFunction copier fd in
+  copy.svar.vname <- fd.svar.vname ^ "_prime_" ^ var;
+  let vis = new seuInstrumentationVisitor var in
+  let copy = Cil.visitCilFunction (vis :> Cil.cilVisitor) copy in
+  if Select_site.get () && vis#sites > 0 then begin
+    let loc = match copy.sbody.bstmts with
+      | s :: _ -> Cil_datatype.Stmt.loc s
+      | [] -> Cil_datatype.Location.unknown
+    in
+    let select = seu_function "simulate_seu_select" ["num_sites", Cil.intType, []] in
+    let call = Call (None, Cil.evar ~loc select, [Cil.integer ~loc vis#sites], loc) in
+    copy.sbody.bstmts <- Cil.mkStmtOneInstr ~valid_sid:true call :: copy.sbody.bstmts
+  end;
+  Self.feedback "%s: %d injection sites" copy.svar.vname vis#sites;
+  copy
+
+(* Copy the original source verbatim (without CRs) and append the instrumented copies *)
+let write_output (combine : string) (output : string) (copies : (fundec * location) list) =
+  let oc = open_out output in
+  if combine <> "" then begin
+    let ic = open_in_bin combine in
+    (try
+       while true do
+         let line = input_line ic in
+         let len = String.length line in
+         if len > 0 && line.[len - 1] = '\r' then output_substring oc line 0 (len - 1)
+         else output_string oc line;
+         output_char oc '\n'
+       done
+     with End_of_file -> ());
+    close_in ic;
+    output_string oc "\n\n// ----- Renamed Instrumented Function -----\n\n"
+  end;
+  let fmt = Format.formatter_of_out_channel oc in
+  List.iter (fun (fd, loc) -> Format.fprintf fmt "%a@.@." Printer.pp_global (GFun (fd, loc))) copies;
+  close_out oc
+
+(* Loop bounds (-seu-unwindset), run on a _cbmc_ready.c file so that its loop numbers are CBMC's.
+   A loop is bounded by a counter: a local read by its exit test whose only write in the body is one
+   unconditional i = i +/- c, so every exit test sees a new value and there are at most as many tests
+   as values EVA gives the counter there. CBMC needs one unwinding per test, the iterations plus the
+   exit, and numbers the loops of a function in the order of their back edges, inner loops first. *)
+let rec strip_casts (e : exp) : exp =
+  match e.enode with
+  | CastE (_, e) -> strip_casts e
+  | _ -> e
+
+let is_step (vi : varinfo) (e : exp) : bool =
+  match (strip_casts e).enode with
+  | BinOp ((PlusA | MinusA), a, c, _) ->
+      (match (strip_casts a).enode, (strip_casts c).enode with
+       | Lval (Var v, NoOffset), Const (CInt64 (k, _, _)) ->
+           Cil_datatype.Varinfo.equal v vi && not (Integer.is_zero k)
+       | _ -> false)
+  | _ -> false
+
+(* Statements of a block that run on every iteration, looking through nested blocks *)
+let rec unconditional (b : block) : stmt list =
+  List.concat_map (fun s ->
+      match s.skind with
+      | Block b -> unconditional b
+      | UnspecifiedSequence seq -> unconditional (Cil.mkBlock (List.map (fun (s, _, _, _, _) -> s) seq))
+      | _ -> [s])
+    b.bstmts
+
+(* Writes per variable in a block, and whether control can jump back to the test without the step *)
+class writesVisitor = object
+  inherit Cil.nopCilVisitor
+  val writes : (int, int) Hashtbl.t = Hashtbl.create 8
+  val mutable jumps = false
+
+  method writes vi = try Hashtbl.find writes vi.vid with Not_found -> 0
+  method jumps = jumps
+
+  method! vinst i =
+    (match i with
+     | Set ((Var vi, NoOffset), _, _) | Call (Some (Var vi, NoOffset), _, _, _) | Local_init (vi, _, _) ->
+         Hashtbl.replace writes vi.vid (1 + (try Hashtbl.find writes vi.vid with Not_found -> 0))
+     | _ -> ());
+    Cil.SkipChildren
+
+  method! vstmt s =
+    (match s.skind with
+     | Goto _ | Continue _ -> jumps <- true
+     | _ -> ());
+    Cil.DoChildren
+end
+
+let loop_bound (body : block) : int option =
+  match body.bstmts with
+  | ({ skind = If (test, _, _, _); _ } as head) :: _ ->
+      let vis = new writesVisitor in
+      ignore (Cil.visitCilBlock (vis :> Cil.cilVisitor) body);
+      let steps = unconditional body in
+      let is_counter vi =
+        not vi.vglob && not vi.vaddrof && Cil.isIntegralType vi.vtype && vis#writes vi = 1
+        && List.exists (fun s ->
+            match s.skind with
+            | Instr (Set ((Var v, NoOffset), e, _)) -> Cil_datatype.Varinfo.equal v vi && is_step vi e
+            | _ -> false) steps
+      in
+      let bound vi =
+        match Eva.Results.(before head |> eval_var vi |> as_ival) with
+        | Ok ival ->
+            (match Ival.min_max_r_mod ival with
+             | Some lo, Some hi, _, m ->
+                 let m = if Integer.le m Integer.zero then Integer.one else m in
+                 (try Some (Integer.to_int_exn (Integer.succ (Integer.e_div (Integer.sub hi lo) m)))
+                  with _ -> None)
+             | _ -> None)
+        | Error _ -> None
+      in
+      if vis#jumps then None
+      else
+        Cil_datatype.Varinfo.Set.fold (fun vi acc ->
+            match (if is_counter vi then bound vi else None), acc with
+            | Some k, Some k' -> Some (min k k')
+            | Some k, None | None, Some k -> Some k
+            | None, None -> None)
+          (Cil.extract_varinfos_from_exp test) None
+  | _ -> None
+
+(* "f.n:k" for every bounded loop n of f *)
+let unwindset_entries (fd : fundec) : string list =
+  let loops = ref [] in
+  ignore (Cil.visitCilFunction (object
+      inherit Cil.nopCilVisitor
+      method! vstmt s =
+        match s.skind with
+        | Loop (_, body, _, _, _) -> Cil.DoChildrenPost (fun s -> loops := body :: !loops; s)
+        | _ -> Cil.DoChildren
+    end) fd);
+  (* A counter compared with a nondet input gives bounds like 2^31, which would override --unwind *)
+  let max = Unwind_max.get () in
+  List.concat (List.mapi (fun n body ->
+      match loop_bound body with
+      | Some k when max <= 0 || k <= max -> [Printf.sprintf "%s.%d:%d" fd.svar.vname n k]
+      | Some k ->
+          Self.feedback "loop %s.%d: EVA bound %d above %d, left to --unwind" fd.svar.vname n k max;
+          []
+      | None -> [])
+      (List.rev !loops))
+
+let write_unwindset (file : string) =
+  Eva.Analysis.compute ();
+  let entries = ref [] in
+  Globals.Functions.iter_on_fundecs (fun fd -> entries := !entries @ unwindset_entries fd);
+  let oc = open_out file in
+  output_string oc (String.concat "," !entries);
+  output_char oc '\n';
+  close_out oc;
+  Self.result "%d loop bounds written to %s" (List.length !entries) file
+
+let run () =
+  if Unwindset.get () <> "" then write_unwindset (Unwindset.get ());
+  if Entry.get () <> "" && not (Variables.is_empty ()) then begin
+    if Output.get () = "" then Self.abort "-seu-entry needs -seu-output <file>";
+    let entry = Entry.get () in
+    let fd, loc =
+      let found = ref None in
+      Cil.iterGlobals (Ast.get ()) (function
+        | GFun (fd, loc) when fd.svar.vname = entry -> found := Some (fd, loc)
+        | _ -> ());
+      match !found with
+      | Some f -> f
+      | None -> Self.abort "Function %s not found" entry
+    in
+    let output = Output.get () in
+    let per_variable = Str.string_match (Str.regexp ".*%v") output 0 in
+    if per_variable then
+      (* One file per candidate, so each one can be checked (and cached) on its own *)
+      List.iter (fun v ->
+          let file = Str.global_replace (Str.regexp_string "%v") v output in
+          write_output (Combine.get ()) file [instrument_copy fd v, loc];
+          Self.result "Instrumented copy for %s written to %s" v file)
+        (Variables.get ())
+    else begin
+      let copies = List.map (fun v -> instrument_copy fd v, loc) (Variables.get ()) in
+      write_output (Combine.get ()) output copies;
+      Self.result "Instrumented copies written to %s" output
+    end
+  end
+
+let () = Boot.Main.extend run